@@ -5,6 +5,9 @@
 #include "vert_db_types.h"
 #include "vert_db_item.h"
 #include "vert_db_utils.h"
+#include "vert_db_channel.h"
+#include "vert_db_bones.h"
+#include "vert_db_adjacency.h"
 #include "vert_db_cloud.h"
 
 #define VERTDB_MEMBER_CHECK(field, compare) \
@@ -15,11 +18,15 @@
 
 namespace vd
 {
-    template<typename T, typename S = real>
+    // I selects the spatial index used for position/uvw/color queries.
+    //  Any type with point_cloud's insert/find/visit/nearest interface works, such as kd_tree.
+    // M caps the stored influences per vertex, keeping the heaviest M inline with no allocation.
+    //  0 stores every influence.
+    template<typename T, typename S = real, template<typename, typename, typename, typename> class I = point_cloud, size_t M = VERTDB_MAX_INFLUENCES>
     class vert_db
     {
     public:
-        typedef vert_db<T, S> self_type;
+        typedef vert_db<T, S, I, M> self_type;
         typedef T value_type;
         typedef vec3 point_type;
         typedef vec3i point_key_type;
@@ -33,18 +40,25 @@ namespace vd
         typedef VERTDB_MAP<vert_id, key_type> vert_directory;
 
         typedef VERTDB_SET<key_type> vert_manifest;
-        typedef VERTDB_MAP<key_type, key_type> id_storage;
-        typedef VERTDB_MAP<key_type, point_type> point_storage;
-        typedef VERTDB_MAP<key_type, bone_weights_type> weights_storage;
-        typedef VERTDB_MAP<key_type, vert_connects_type> connects_storage;
+        typedef VERTDB_CHANNEL<key_type, key_type> id_storage;
+        typedef VERTDB_CHANNEL<key_type, point_type> point_storage;
+        typedef typename weight_storage_traits<M>::storage_type vert_weights;
+        typedef VERTDB_CHANNEL<key_type, vert_weights> weights_storage;
+        typedef VERTDB_CHANNEL<key_type, vert_connects_type> connects_storage;
 
         typedef db_item_def<value_type> def_type;
-        typedef point_cloud<key_type, point_type, point_key_type, scalar> cloud_type;
+        typedef I<key_type, point_type, point_key_type, scalar> cloud_type;
+        typedef typename cloud_type::point_collection point_collection;
+        typedef typename cloud_type::batch_type batch_type;
 
         typedef VERTDB_BUCKET<key_type> key_collection;
         typedef key_collection results_type;
         typedef VERTDB_SET<key_type> key_set;
         typedef VERTDB_BUCKET<scalar> scalar_collection;
+        typedef VERTDB_PAIR<key_type, def_type> staged_edit;
+        typedef VERTDB_BUCKET<staged_edit> staged_collection;
+        typedef compiled_adjacency<key_type> adjacency_type;
+        typedef traversal_context<key_type> traversal_type;
 
         typedef typename const vert_manifest::iterator const_iterator;
 
@@ -55,6 +69,11 @@ namespace vd
             return limits_type::epsilon() * VERTDB_EPSILON_SCALE;
         }
 
+        static inline constexpr size_t max_influences()
+        {
+            return M;
+        }
+
         static inline def_type make_def()
         {
             def_type result;
@@ -65,17 +84,30 @@ namespace vd
             : m_data()
             , m_manifest()
             , m_directory()
+            , m_shared_ids( false )
             , m_ids()
             , m_positions()
             , m_normals()
             , m_uvws()
             , m_colors()
             , m_weights()
+            , m_bones()
             , m_connects()
             , m_pos_cloud()
             , m_uvw_cloud()
             , m_color_cloud()
-            , m_mutex_edit()
+            , m_auto_rebucket( false )
+            , m_rebucket_at( VERTDB_AUTO_REBUCKET_MIN )
+            , m_erased( 0 )
+            , m_indexed( k_item_none )
+            , m_index_mutex()
+            , m_adjacency()
+            , m_adjacency_valid( false )
+            , m_adjacency_mutex()
+            , m_write_shards()
+            , m_pos_cloud_mutex()
+            , m_uvw_cloud_mutex()
+            , m_color_cloud_mutex()
         {
         }
 
@@ -90,7 +122,7 @@ namespace vd
             result.gather_normal( key, m_normals );
             result.gather_uvw( key, m_uvws );
             result.gather_color( key, m_colors );
-            result.gather_weights( key, m_weights );
+            gather_weights( key, result );
             result.gather_connects( key, m_connects );
 
             return true;
@@ -98,7 +130,13 @@ namespace vd
 
         size_t size() const
         {
-            return m_data.size();
+            return m_data.size() - m_erased;
+        }
+
+        // Keys freed by erase() that compact() has not reclaimed yet
+        size_t erased_count() const
+        {
+            return m_erased;
         }
 
         const_iterator begin() const
@@ -111,18 +149,193 @@ namespace vd
             return m_manifest.end();
         }
 
+        void reserve( size_t count )
+        {
+            m_data.reserve( count );
+            m_manifest.reserve( count );
+            m_ids.reserve( count );
+            m_positions.reserve( count );
+            m_normals.reserve( count );
+            m_uvws.reserve( count );
+            m_colors.reserve( count );
+            m_weights.reserve( count );
+            m_connects.reserve( count );
+        }
+
         key_type insert( const def_type &def )
         {
             key_type key = m_data.size();
             m_data.emplace_back( def.user_data );
 
             apply_def( key, def );
+
+            if( m_auto_rebucket && ( m_data.size() >= m_rebucket_at ) )
+            {
+                auto_rebucket();
+                m_rebucket_at = m_data.size() * 2;
+            }
+
             return key;
         }
 
+        // Insert every def in [begin, end), returning the key of the first.  Keys are consecutive.
+        //  Storage is reserved up front and the clouds and directory are built once at the end,
+        //  each on its own task, instead of being maintained per insert.
+        template<typename It>
+        key_type insert_batch( const It &begin, const It &end )
+        {
+            key_type first = m_data.size();
+            reserve( first + VERTDB_ITERATOR_DISTANCE( begin, end ) );
+
+            for( auto it = begin; it != end; ++it )
+            {
+                const def_type &def = *it;
+                key_type key = m_data.size();
+                m_data.emplace_back( def.user_data );
+                m_manifest.emplace( key );
+                apply_channels( key, def );
+            }
+
+            finish_batch( first );
+            return first;
+        }
+
+        // insert_batch from parallel arrays.  normals and weights may be empty, otherwise they match positions.
+        key_type insert_batch( const point_collection &positions, const point_collection &normals = point_collection(), const VERTDB_BUCKET<bone_weights> &weights = VERTDB_BUCKET<bone_weights>() )
+        {
+            key_type first = m_data.size();
+            size_t count = positions.size();
+            reserve( first + count );
+
+            bool has_normals = normals.size() == count;
+            bool has_weights = weights.size() == count;
+
+            for( size_t i = 0; i < count; ++i )
+            {
+                key_type key = first + i;
+                m_data.emplace_back();
+                m_manifest.emplace( key );
+
+                m_positions[key] = positions[i];
+                if( has_normals )
+                    m_normals[key] = normals[i];
+
+                if( has_weights )
+                    m_bones.intern<M>( weights[i], m_weights[key] );
+            }
+
+            finish_batch( first );
+            return first;
+        }
+
+        // Apply staged (key, def) edits in [begin, end) in one pass, as update() would one at a time.
+        //  A built cloud the batch moves a large share of is dropped instead, and rebuilt in bulk
+        //  by its next query rather than having points moved one by one.
+        template<typename It>
+        void update_batch( const It &begin, const It &end )
+        {
+            size_t moved_positions = 0;
+            size_t moved_uvws = 0;
+            size_t moved_colors = 0;
+            for( auto it = begin; it != end; ++it )
+            {
+                const def_type &def = it->second;
+                moved_positions += def.has_position() ? 1 : 0;
+                moved_uvws += def.has_uvw() ? 1 : 0;
+                moved_colors += def.has_color() ? 1 : 0;
+            }
+
+            release_moved( m_pos_cloud, k_item_position, moved_positions );
+            release_moved( m_uvw_cloud, k_item_uvw, moved_uvws );
+            release_moved( m_color_cloud, k_item_color, moved_colors );
+
+            for( auto it = begin; it != end; ++it )
+            {
+                apply_def( it->first, it->second );
+            }
+        }
+
+        // Re-tune every cloud's bucket width as the db grows (each time the vertex count doubles)
+        void set_auto_rebucket( bool enabled )
+        {
+            m_auto_rebucket = enabled;
+        }
+
+        // Re-tune every built cloud's bucket width to its current point density
+        void auto_rebucket()
+        {
+            if( is_indexed( k_item_position ) )
+                m_pos_cloud.auto_rebucket();
+
+            if( is_indexed( k_item_uvw ) )
+                m_uvw_cloud.auto_rebucket();
+
+            if( is_indexed( k_item_color ) )
+                m_color_cloud.auto_rebucket();
+        }
+
+        // Pack every built cloud into its read-mostly layout; later edits unpack them again
+        void freeze()
+        {
+            if( is_indexed( k_item_position ) )
+                m_pos_cloud.freeze();
+
+            if( is_indexed( k_item_uvw ) )
+                m_uvw_cloud.freeze();
+
+            if( is_indexed( k_item_color ) )
+                m_color_cloud.freeze();
+        }
+
+        // Build the indices named by flags now rather than on the first query that needs them.
+        //  k_item_position, k_item_uvw and k_item_color build the clouds, k_item_id the id directory
+        //  and k_item_connects the adjacency.  Built indices are kept current by later edits.
+        void build_indices( item_flags flags = k_item_all ) const
+        {
+            if( flag_is_set( flags, k_item_id ) )
+                directory_index();
+
+            if( flag_is_set( flags, k_item_position ) )
+                position_index();
+
+            if( flag_is_set( flags, k_item_uvw ) )
+                uvw_index();
+
+            if( flag_is_set( flags, k_item_color ) )
+                color_index();
+
+            if( flag_is_set( flags, k_item_connects ) )
+                adjacency();
+        }
+
+        // Indices that currently exist, as item flags (see build_indices)
+        item_flags built_indices() const
+        {
+            item_flags result = static_cast<item_flags>( m_indexed.load() );
+            if( m_adjacency_valid )
+                result |= k_item_connects;
+
+            return result;
+        }
+
+        const cloud_type& position_cloud() const
+        {
+            return position_index();
+        }
+
+        const cloud_type& uvw_cloud() const
+        {
+            return uvw_index();
+        }
+
+        const cloud_type& color_cloud() const
+        {
+            return color_index();
+        }
+
         key_type insert_atomic( const def_type &def )
         {
-            lock_type lock( m_mutex_edit );
+            exclusive_edit edit( *this );
             return insert( def );
         }
 
@@ -170,16 +383,128 @@ namespace vd
             apply_def( key, def );
         }
 
+        // Remove a vertex from every channel and index.
+        //  Its key is left as a tombstone, so other keys stay valid until compact().
+        bool erase( const key_type &key )
+        {
+            auto found = m_manifest.find( key );
+            if( found == m_manifest.end() )
+                return false;
+
+            m_manifest.erase( found );
+
+            retire_id( key );
+
+            if( is_indexed( k_item_position ) )
+                erase_from_cloud( m_pos_cloud, m_positions, key );
+
+            if( is_indexed( k_item_uvw ) )
+                erase_from_cloud( m_uvw_cloud, m_uvws, key );
+
+            if( is_indexed( k_item_color ) )
+                erase_from_cloud( m_color_cloud, m_colors, key );
+
+            m_adjacency_valid = false;
+
+            m_ids.erase( key );
+            m_positions.erase( key );
+            m_normals.erase( key );
+            m_uvws.erase( key );
+            m_colors.erase( key );
+            m_weights.erase( key );
+            m_connects.erase( key );
+
+            if( key < m_data.size() )
+            {
+                m_data[key] = value_type{};
+                ++m_erased;
+            }
+
+            return true;
+        }
+
+        // Erase every key in keys, returning how many were present
+        size_t erase_batch( const key_collection &keys )
+        {
+            size_t erased = 0;
+            for( const auto &key : keys )
+            {
+                if( erase( key ) )
+                    ++erased;
+            }
+
+            return erased;
+        }
+
+        // Renumber live keys densely, in their current order, and drop every tombstone.
+        //  Returns the new key for each old key, or c_invalid_vert_id for erased ones.
+        //  Built indices are rebuilt, with clouds in their mutable layout.
+        key_collection compact()
+        {
+            key_collection remap( m_data.size(), c_invalid_vert_id );
+
+            value_collection data;
+            data.reserve( m_data.size() - m_erased );
+            for( key_type key = 0; key < m_data.size(); ++key )
+            {
+                if( m_manifest.find( key ) == m_manifest.end() )
+                    continue;
+
+                remap[key] = data.size();
+                data.emplace_back( VERTDB_MOVE( m_data[key] ) );
+            }
+
+            vert_manifest manifest;
+            for( key_type key = 0; key < data.size(); ++key )
+            {
+                manifest.emplace( key );
+            }
+
+            compact_channel( m_ids, remap );
+            compact_channel( m_positions, remap );
+            compact_channel( m_normals, remap );
+            compact_channel( m_uvws, remap );
+            compact_channel( m_colors, remap );
+            compact_channel( m_weights, remap );
+            compact_channel( m_connects, remap );
+
+            m_data = VERTDB_MOVE( data );
+            m_manifest = VERTDB_MOVE( manifest );
+            m_erased = 0;
+
+            // Every index refers to old keys, so rebuild whichever are built now
+            item_flags built = built_indices();
+            release_indices();
+            build_indices( built );
+
+            return remap;
+        }
+
+        // Thread safe update.  Only key's write shard is locked when def can be written in place;
+        //  edits that would reshape shared structures lock every shard instead.
         void update_atomic( const key_type &key, const def_type &def )
         {
-            lock_type lock( m_mutex_edit );
+            {
+                lock_type lock( m_write_shards[write_shard( key )] );
+                if( writes_in_place( key, def ) )
+                {
+                    apply_in_place( key, def );
+                    return;
+                }
+            }
+
+            exclusive_edit edit( *this );
             update( key, def );
+
+            // Give every key a slot in the channels in use so later writes to them stay in place
+            extend_channels( m_data.size() );
         }
 
         key_type find_id( const vert_id &id ) const
         {
-            auto found = m_directory.find( id );
-            if( found == m_directory.end() )
+            const vert_directory &directory = directory_index();
+            auto found = directory.find( id );
+            if( found == directory.end() )
                 return c_invalid_vert_id;
 
             return found->second;
@@ -187,23 +512,58 @@ namespace vd
 
         results_type find_position( const point_type &location, scalar radius=epsilon() ) const
         {
-            return m_pos_cloud.find( location, radius );
+            return position_index().find( location, radius );
+        }
+
+        // Fills results with keys near location, reusing its storage between queries
+        void find_position( const point_type &location, scalar radius, results_type &results ) const
+        {
+            position_index().find( location, radius, results );
+        }
+
+        // Calls visitor( key, distance_squared ) for every key near location
+        template<typename F>
+        void visit_position( const point_type &location, scalar radius, F visitor ) const
+        {
+            position_index().visit( location, radius, visitor );
+        }
+
+        // Radius query around every location, packed as offsets into one hit array
+        batch_type find_position_batch( const point_collection &locations, scalar radius=epsilon() ) const
+        {
+            return position_index().find_batch( locations, radius );
+        }
+
+        // Keys near location along with their squared distances, straight from the radius test
+        void find_position_distances( const point_type &location, scalar radius, results_type &results, scalar_collection &dist_sq ) const
+        {
+            results.clear();
+            dist_sq.clear();
+
+            position_index().visit( location, radius, [&]( const key_type &key, scalar distance_sq )
+            {
+                results.emplace_back( key );
+                dist_sq.emplace_back( distance_sq );
+            } );
         }
 
         results_type find_position_sorted( const point_type &location, scalar radius = epsilon() ) const
         {
-            auto keys = m_pos_cloud.find( location, radius );
-            auto distances = distances_to( location, keys );
+            typedef VERTDB_PAIR<scalar, key_type> distance_pair;
+            VERTDB_BUCKET<distance_pair> found;
+
+            position_index().visit( location, radius, [&]( const key_type &key, scalar dist_sq )
+            {
+                found.emplace_back( dist_sq, key );
+            } );
 
-            sort_indicies_by_factor sorter( distances );
-            VERTDB_BUCKET<size_t> indices( keys.size(), 0 );
-            VERTDB_IOTA( indices.begin(), indices.end(), 0 );
-            VERTDB_BUCKET_SORTER( indices.begin(), indices.end(), sorter );
+            VERTDB_BUCKET_SORTER( found.begin(), found.end() );
 
-            decltype( keys ) results( keys.size() );
-            for( auto index : indices )
+            results_type results;
+            results.reserve( found.size() );
+            for( const auto &pair : found )
             {
-                results.emplace_back( keys[index] );
+                results.emplace_back( pair.second );
             }
 
             return results;
@@ -211,12 +571,87 @@ namespace vd
 
         results_type find_uvw( const point_type &location, scalar radius=epsilon() ) const
         {
-            return m_uvw_cloud.find( location, radius );
+            return uvw_index().find( location, radius );
+        }
+
+        void find_uvw( const point_type &location, scalar radius, results_type &results ) const
+        {
+            uvw_index().find( location, radius, results );
+        }
+
+        template<typename F>
+        void visit_uvw( const point_type &location, scalar radius, F visitor ) const
+        {
+            uvw_index().visit( location, radius, visitor );
         }
 
         results_type find_color( const point_type &location, scalar radius = epsilon() ) const
         {
-            return m_color_cloud.find( location, radius );
+            return color_index().find( location, radius );
+        }
+
+        void find_color( const point_type &location, scalar radius, results_type &results ) const
+        {
+            color_index().find( location, radius, results );
+        }
+
+        template<typename F>
+        void visit_color( const point_type &location, scalar radius, F visitor ) const
+        {
+            color_index().visit( location, radius, visitor );
+        }
+
+        batch_type find_uvw_batch( const point_collection &locations, scalar radius=epsilon() ) const
+        {
+            return uvw_index().find_batch( locations, radius );
+        }
+
+        batch_type find_color_batch( const point_collection &locations, scalar radius=epsilon() ) const
+        {
+            return color_index().find_batch( locations, radius );
+        }
+
+        static inline constexpr scalar unlimited()
+        {
+            return limits_type::max();
+        }
+
+        // Nearest key by position within max_radius, or c_invalid_vert_id
+        key_type find_nearest_position( const point_type &location, scalar max_radius=unlimited() ) const
+        {
+            return find_nearest( position_index(), location, max_radius, accept_all() );
+        }
+
+        // Nearest key by position within max_radius whose key satisfies predicate( key )
+        template<typename P>
+        key_type find_nearest_position( const point_type &location, scalar max_radius, P predicate ) const
+        {
+            return find_nearest( position_index(), location, max_radius, predicate );
+        }
+
+        results_type find_k_nearest_position( const point_type &location, size_t count, scalar max_radius=unlimited() ) const
+        {
+            return position_index().find_k_nearest( location, count, max_radius );
+        }
+
+        key_type find_nearest_uvw( const point_type &location, scalar max_radius=unlimited() ) const
+        {
+            return find_nearest( uvw_index(), location, max_radius, accept_all() );
+        }
+
+        results_type find_k_nearest_uvw( const point_type &location, size_t count, scalar max_radius=unlimited() ) const
+        {
+            return uvw_index().find_k_nearest( location, count, max_radius );
+        }
+
+        key_type find_nearest_color( const point_type &location, scalar max_radius=unlimited() ) const
+        {
+            return find_nearest( color_index(), location, max_radius, accept_all() );
+        }
+
+        results_type find_k_nearest_color( const point_type &location, size_t count, scalar max_radius=unlimited() ) const
+        {
+            return color_index().find_k_nearest( location, count, max_radius );
         }
 
         inline results_type find_connects( const key_type &key, size_t depth = 1, bool inclusive = false ) const
@@ -227,34 +662,32 @@ namespace vd
         }
 
         results_type find_connects( key_collection &frontier, size_t depth=1, bool inclusive=false ) const
+        {
+            return find_connects( frontier, depth, inclusive, local_traversal() );
+        }
+
+        // find_connects with caller owned visited marks, reusable across queries without clearing
+        results_type find_connects( key_collection &frontier, size_t depth, bool inclusive, traversal_type &context ) const
         {
             size_t cursor = 0;
             size_t current_depth = 0;
             size_t sentinal = frontier.size();
             size_t first = ( inclusive ) ? 0 : sentinal;
 
-            key_set seen( frontier.begin(), frontier.end() );
+            const adjacency_type &graph = adjacency();
+            context.begin( m_data.size() );
+            for( const auto &key : frontier )
+            {
+                context.visit( key );
+            }
 
             while( cursor < frontier.size() )
             {
-                const key_type &current_key = frontier[cursor];
-                auto found_connects = m_connects.find( current_key );
-                if( found_connects != m_connects.end() )
+                const key_type current_key = frontier[cursor];
+                for( const key_type &found_key : graph.neighbours( current_key ) )
                 {
-                    const auto &connects = found_connects->second;
-                    for( const auto &connect : connects )
-                    {
-                        key_type found_key = find_id( connect );
-                        if( found_key != c_invalid_vert_id )
-                        {
-                            auto found_seen = seen.find( found_key );
-                            if( found_seen == seen.end() )
-                            {
-                                frontier.emplace_back( found_key );
-                                seen.emplace( found_key );
-                            }
-                        }
-                    }
+                    if( context.visit( found_key ) )
+                        frontier.emplace_back( found_key );
                 }
 
                 ++cursor;
@@ -273,109 +706,335 @@ namespace vd
             return results;
         }
 
-        static bool weight_sort( const bone_weight &a, const bone_weight &b )
-        {
-            return a.second > b.second;
-        }
-
-        bone_weights find_weights(const point_type &location, real radius, size_t total=0, real clip=.1f, bool normalize=true) const
+        // Level synchronous find_connects that expands large levels across the thread pool.
+        //  Matches find_connects except that keys within each level come back in no particular order.
+        results_type find_connects_parallel( const key_collection &sources, size_t depth, bool inclusive, traversal_type &context ) const
         {
-            bone_weights results;
-
-            results_type verts = find_position( location, radius );
-            if( verts.empty() )
-                return results;
-
-            size_t count = verts.size();
-            scalar_collection distances = distances_to( location, verts );
-
-            // We'll use a radius factor instead of the standard deviation
-            //  Because the user probably intends a filter from their query point
-            //  Not a weighting around what was in the radius query, in case those results were biased.
-            //scalar sigma = deviation<scalar_collection>( distances.begin(), distances.end() );
-            scalar sigma = radius / 2;
+            const adjacency_type &graph = adjacency();
+            context.begin( m_data.size() );
 
-            for( size_t i = 0; i < count; ++i )
+            results_type results;
+            key_collection level;
+            for( const auto &key : sources )
             {
-                scalar weighting = gaussian_weight( distances[i], sigma );
-                accumulate_weight( results, verts[i], weighting );
+                if( context.visit( key ) )
+                    level.emplace_back( key );
             }
 
-            if( (total > 0) && (results.size() > total) )
-            {
-                VERTDB_BUCKET_SORTER( results.begin(), results.end(), weight_sort );
-                results.resize( total );
-            }
+            if( inclusive )
+                results = sources;
 
-            if( normalize )
+            size_t level_count = ( depth > 0 ) ? depth : 1;
+            for( size_t current_depth = 0; ( current_depth < level_count ) && !level.empty(); ++current_depth )
             {
-                normalize_weights( results );
-            }
+                key_collection next;
+                if( level.size() < VERTDB_CONNECTS_PARALLEL_LEVEL )
+                {
+                    for( const auto &key : level )
+                    {
+                        for( const key_type &found_key : graph.neighbours( key ) )
+                        {
+                            if( context.visit( found_key ) )
+                                next.emplace_back( found_key );
+                        }
+                    }
+                }
+                else
+                {
+                    connects_level_func func{ graph, context };
+                    connects_level_processor processor( func, level.begin(), level.end(), next );
+                    processor.join();
+                }
 
-            clip_weights( results, clip, normalize );
+                results.insert( results.end(), next.begin(), next.end() );
+                level.swap( next );
+            }
 
             return results;
         }
 
-        point_type sample_color( const point_type &location, real radius ) const
+        // Connects resolved to internal keys, compiled on first use after any connect or id edit
+        const adjacency_type& adjacency() const
         {
-            point_type result{};
+            if( m_adjacency_valid )
+                return m_adjacency;
 
-            results_type verts = find_position( location, radius );
-            if( verts.empty() )
-                return result;
-
-            size_t count = verts.size();
-            scalar_collection distances = distances_to( location, verts );
-
-            // We'll use a radius factor instead of the standard deviation
-            //  Because the user probably intends a filter from their query point
-            //  Not a weighting around what was in the radius query, in case those results were biased.
-            //scalar sigma = deviation<scalar_collection>( distances.begin(), distances.end() );
-            scalar sigma = radius / 2;
+            lock_type lock( m_adjacency_mutex );
+            if( m_adjacency_valid )
+                return m_adjacency;
 
-            scalar total_weight = 0;
-            for( size_t i = 0; i < count; ++i )
+            m_adjacency.build( m_data.size(), [this]( const key_type &key, key_collection &neighbours )
             {
-                scalar weighting = gaussian_weight( distances[i], sigma );
-                total_weight += weighting;
-                result = result + (color( verts[i] ) * weighting);
-            }
+                auto found = m_connects.find( key );
+                if( found == m_connects.end() )
+                    return;
 
-            if( total_weight > 0 )
-                result = result * (1 / total_weight);
+                for( const auto &connect : found->second )
+                {
+                    key_type found_key = find_id( connect );
+                    if( found_key != c_invalid_vert_id )
+                        neighbours.emplace_back( found_key );
+                }
+            } );
 
-            return result;
+            m_adjacency_valid = true;
+            return m_adjacency;
         }
 
-        inline vert_id id( key_type key ) const
+        static bool weight_sort( const bone_weight &a, const bone_weight &b )
         {
-            return basic_query( key, m_ids );
+            return a.second > b.second;
         }
 
-        inline point_type position(key_type key) const
+        bone_weights find_weights(const point_type &location, real radius, size_t total=0, real clip=.1f, bool normalize=true) const
         {
-            return basic_query( key, m_positions );
+            return m_bones.resolve( find_weight_indices( location, radius, total, clip, normalize ) );
         }
 
-        inline point_type normal( key_type key ) const
+        // find_weights against this db's bone palette, without converting to names.
+        //  total is clamped to max_influences() when the db caps them.
+        indexed_weights find_weight_indices( const point_type &location, real radius, size_t total=0, real clip=.1f, bool normalize=true ) const
         {
-            return basic_query( key, m_normals );
+            results_type verts;
+            scalar_collection weighting;
+            if( !find_filter( location, radius, verts, weighting ) )
+                return indexed_weights();
+
+            return blend_weight_indices( verts.data(), weighting.data(), verts.size(), total, clip, normalize );
         }
 
-        inline point_type uvw( key_type key ) const
+        point_type sample_color( const point_type &location, real radius ) const
         {
-            return basic_query( key, m_uvws );
+            results_type verts;
+            scalar_collection weighting;
+            if( !find_filter( location, radius, verts, weighting ) )
+                return point_type{};
+
+            return blend_color( verts.data(), weighting.data(), verts.size() );
         }
 
-        inline point_type color( key_type key ) const
+        // Gaussian filtered sample of every channel in flags around location, from one radius query.
+        //  See blend_channels for how each channel is combined.  Returns false if nothing is in range.
+        bool sample( const point_type &location, real radius, item_flags flags, def_type &result, size_t total=0, real clip=.1f, bool normalize=true ) const
         {
-            return basic_query( key, m_colors );
+            results_type verts;
+            scalar_collection weighting;
+            if( !find_filter( location, radius, verts, weighting ) )
+                return false;
+
+            blend_channels( verts.data(), weighting.data(), verts.size(), flags, result, total, clip, normalize );
+            return true;
+        }
+
+        // Keys within radius of location and the gaussian filter weight of each, with the nearest key first
+        bool find_filter( const point_type &location, scalar radius, results_type &verts, scalar_collection &weighting ) const
+        {
+            scalar_collection dist_sq;
+            find_position_distances( location, radius, verts, dist_sq );
+            if( verts.empty() )
+                return false;
+
+            size_t nearest = VERTDB_MIN_ELEMENT( dist_sq.begin(), dist_sq.end() ) - dist_sq.begin();
+            VERTDB_SWAP( verts[0], verts[nearest] );
+            VERTDB_SWAP( dist_sq[0], dist_sq[nearest] );
+
+            filter_weights( radius, dist_sq, weighting );
+            return true;
+        }
+
+        // Gaussian filter weight for each of dist_sq, as sample_color and find_weights apply to a radius query
+        static void filter_weights( scalar radius, const scalar_collection &dist_sq, scalar_collection &results )
+        {
+            // We'll use a radius factor instead of the standard deviation
+            //  Because the user probably intends a filter from their query point
+            //  Not a weighting around what was in the radius query, in case those results were biased.
+            //scalar sigma = deviation<scalar_collection>( distances.begin(), distances.end() );
+            scalar sigma = radius / 2;
+
+            results.resize( dist_sq.size() );
+            for( size_t i = 0; i < dist_sq.size(); ++i )
+            {
+                results[i] = gaussian_weight_sq( dist_sq[i], sigma );
+            }
+        }
+
+        // Weights of verts[0, count) blended by weighting, then trimmed to total, normalized and clipped like find_weights
+        indexed_weights blend_weight_indices( const key_type *verts, const scalar *weighting, size_t count, size_t total=0, real clip=.1f, bool normalize=true ) const
+        {
+            indexed_weights results;
+            for( size_t i = 0; i < count; ++i )
+            {
+                accumulate_weight( results, verts[i], weighting[i] );
+            }
+
+            finish_weights( results, total, clip, normalize );
+            return results;
+        }
+
+        // Set every channel in flags on result from verts[0, count), walking them once.
+        //  Colors and uvws are weighted averages, normals are averaged then brought back to unit length
+        //  and weights are blended like blend_weight_indices.  Ids and connects come from verts[0],
+        //  positions are left alone.
+        void blend_channels( const key_type *verts, const scalar *weighting, size_t count, item_flags flags, def_type &result, size_t total=0, real clip=.1f, bool normalize=true ) const
+        {
+            if( count == 0 )
+                return;
+
+            bool blend_colors = flag_is_set( flags, k_item_color );
+            bool blend_normals = flag_is_set( flags, k_item_normal );
+            bool blend_uvws = flag_is_set( flags, k_item_uvw );
+            bool blend_weights = flag_is_set( flags, k_item_weights );
+
+            point_type color_sum{};
+            point_type normal_sum{};
+            point_type uvw_sum{};
+            indexed_weights weights;
+            scalar total_weight = 0;
+
+            for( size_t i = 0; i < count; ++i )
+            {
+                const key_type &key = verts[i];
+                scalar weighting_i = weighting[i];
+                total_weight += weighting_i;
+
+                if( blend_colors )
+                    color_sum = color_sum + ( color( key ) * weighting_i );
+
+                if( blend_normals )
+                    normal_sum = normal_sum + ( normal( key ) * weighting_i );
+
+                if( blend_uvws )
+                    uvw_sum = uvw_sum + ( uvw( key ) * weighting_i );
+
+                if( blend_weights )
+                    accumulate_weight( weights, key, weighting_i );
+            }
+
+            scalar inv_total = ( total_weight > 0 ) ? ( 1 / total_weight ) : 0;
+
+            if( flag_is_set( flags, k_item_id ) )
+                result.set_id( id( verts[0] ) );
+
+            if( blend_colors )
+                result.set_color( color_sum * inv_total );
+
+            if( blend_uvws )
+                result.set_uvw( uvw_sum * inv_total );
+
+            // Opposing normals can cancel out, so fall back to the nearest
+            if( blend_normals )
+            {
+                scalar length_sq = dot( normal_sum, normal_sum );
+                result.set_normal( ( length_sq > 0 ) ? normal_sum * ( 1 / sqrt( length_sq ) ) : normal( verts[0] ) );
+            }
+
+            if( blend_weights )
+            {
+                finish_weights( weights, total, clip, normalize );
+                result.set_weights( m_bones.resolve( weights ) );
+            }
+
+            // TODO: This can technically create one-way connects.  Maybe shouldn't?
+            //       This should be consistent with ID query.
+            //       Problem comes with multiple items sharing an ID.
+            //       ID dupes should shake out during insert to results DB though.
+            if( flag_is_set( flags, k_item_connects ) )
+                result.set_connects( connects( verts[0] ) );
+        }
+
+        // Colors of verts[0, count) averaged by weighting
+        point_type blend_color( const key_type *verts, const scalar *weighting, size_t count ) const
+        {
+            point_type result{};
+
+            scalar total_weight = 0;
+            for( size_t i = 0; i < count; ++i )
+            {
+                total_weight += weighting[i];
+                result = result + (color( verts[i] ) * weighting[i]);
+            }
+
+            if( total_weight > 0 )
+                result = result * (1 / total_weight);
+
+            return result;
+        }
+
+        inline vert_id id( key_type key ) const
+        {
+            return basic_query( key, m_ids );
+        }
+
+        inline point_type position(key_type key) const
+        {
+            return basic_query( key, m_positions );
+        }
+
+        inline point_type normal( key_type key ) const
+        {
+            return basic_query( key, m_normals );
+        }
+
+        inline point_type uvw( key_type key ) const
+        {
+            return basic_query( key, m_uvws );
+        }
+
+        inline point_type color( key_type key ) const
+        {
+            return basic_query( key, m_colors );
         }
 
         inline bone_weights weights( key_type key ) const
         {
-            return basic_query( key, m_weights );
+            auto found = m_weights.find( key );
+            if( found == m_weights.end() )
+                return bone_weights{};
+
+            return m_bones.resolve( found->second );
+        }
+
+        inline indexed_weights weight_indices( key_type key ) const
+        {
+            auto found = m_weights.find( key );
+            if( found == m_weights.end() )
+                return indexed_weights{};
+
+            return indexed_weights( found->second.begin(), found->second.end() );
+        }
+
+        // Flags for every channel key has a value in
+        item_flags channels( key_type key ) const
+        {
+            item_flags result = k_item_none;
+            if( m_ids.find( key ) != m_ids.end() )
+                result |= k_item_id;
+
+            if( m_positions.find( key ) != m_positions.end() )
+                result |= k_item_position;
+
+            if( m_normals.find( key ) != m_normals.end() )
+                result |= k_item_normal;
+
+            if( m_uvws.find( key ) != m_uvws.end() )
+                result |= k_item_uvw;
+
+            if( m_colors.find( key ) != m_colors.end() )
+                result |= k_item_color;
+
+            if( m_weights.find( key ) != m_weights.end() )
+                result |= k_item_weights;
+
+            if( m_connects.find( key ) != m_connects.end() )
+                result |= k_item_connects;
+
+            return result;
+        }
+
+        // Names for the bone indices used by weight_indices and find_weight_indices
+        const bone_palette& bones() const
+        {
+            return m_bones;
         }
 
         inline vert_connects connects( key_type key ) const
@@ -412,6 +1071,27 @@ namespace vd
             return sqrt( dist_sq );
         }
 
+        // Squared distance from point to every key, in order.  Skips the sqrt for callers that compare or weight by dist_sq.
+        void distances_sq_to( const point_type &point, const key_collection &verts, scalar_collection &results ) const
+        {
+            results.resize( verts.size() );
+            for( size_t i = 0; i < verts.size(); ++i )
+            {
+                point_type between = position( verts[i] ) - point;
+                results[i] = dot( between, between );
+            }
+        }
+
+        // Distance from point to every key, in order
+        void distances_to( const point_type &point, const key_collection &verts, scalar_collection &results ) const
+        {
+            distances_sq_to( point, verts, results );
+            for( auto &value : results )
+            {
+                value = sqrt( value );
+            }
+        }
+
         bool channel_equal( const self_type &other, item_flags flags ) const
         {
             if( flag_is_set(flags, k_item_id ) )
@@ -426,8 +1106,8 @@ namespace vd
             if( flag_is_set( flags, k_item_uvw ) )
                 VERTDB_MEMBER_CHECK( m_uvws, other );
 
-            if( flag_is_set( flags, k_item_weights ) )
-                VERTDB_MEMBER_CHECK( m_weights, other );
+            if( flag_is_set( flags, k_item_weights ) && !weights_equal( other ) )
+                return false;
 
             if( flag_is_set( flags, k_item_connects ) )
                 VERTDB_MEMBER_CHECK( m_connects, other );
@@ -442,7 +1122,9 @@ namespace vd
         {
             VERTDB_MEMBER_CHECK( size(), other );
             VERTDB_MEMBER_CHECK( m_manifest, other );
-            VERTDB_MEMBER_CHECK( m_directory, other );
+
+            if( directory_index() != other.directory_index() )
+                return false;
 
             return channel_equal( other, k_item_all );
         }
@@ -454,28 +1136,109 @@ namespace vd
 
     protected:
 
+        // Expands one key of a find_connects_parallel level, claiming neighbours atomically
+        struct connects_level_func
+        {
+            void operator()( const key_type &key, key_collection &collector ) const
+            {
+                for( const key_type &found_key : m_graph.neighbours( key ) )
+                {
+                    if( m_context.claim( found_key ) )
+                        collector.emplace_back( found_key );
+                }
+            }
+
+            const adjacency_type &m_graph;
+            traversal_type &m_context;
+        };
+
+        typedef threaded_processor<connects_level_func, typename key_collection::const_iterator, key_collection> connects_level_processor;
+
+        // Visited marks reused by find_connects calls that don't supply their own
+        static traversal_type& local_traversal()
+        {
+            static thread_local traversal_type context;
+            return context;
+        }
+
+        struct accept_all
+        {
+            bool operator()( const key_type & ) const
+            {
+                return true;
+            }
+        };
+
+        template<typename P>
+        static inline key_type find_nearest( const cloud_type &cloud, const point_type &location, scalar max_radius, P predicate )
+        {
+            key_type result = c_invalid_vert_id;
+            if( !cloud.find_nearest( location, result, max_radius, predicate ) )
+                return c_invalid_vert_id;
+
+            return result;
+        }
+
         inline scalar_collection distances_to( const point_type &location, key_collection &verts ) const
         {
             scalar_collection distances;
-            distances.reserve( verts.size() );
-            for( const auto &key : verts )
+            distances_to( location, verts, distances );
+            return distances;
+        }
+
+        static bool indexed_weight_sort( const indexed_weight &a, const indexed_weight &b )
+        {
+            return a.second > b.second;
+        }
+
+        inline void gather_weights( const key_type &key, def_type &result ) const
+        {
+            auto found = m_weights.find( key );
+            if( found != m_weights.end() )
+                result.set_weights( m_bones.resolve( found->second ) );
+        }
+
+        // Weight channels match by bone name, even if the two palettes interned bones in different orders
+        bool weights_equal( const self_type &other ) const
+        {
+            if( m_bones == other.m_bones )
+                return m_weights == other.m_weights;
+
+            for( const auto &entry : m_weights )
             {
-                real dist = distance_to( location, key );
-                distances.emplace_back( dist );
+                auto found = other.m_weights.find( entry.first );
+                if( found == other.m_weights.end() )
+                    return false;
+
+                if( m_bones.resolve( entry.second ) != other.m_bones.resolve( found->second ) )
+                    return false;
             }
 
-            return distances;
+            for( const auto &entry : other.m_weights )
+            {
+                if( m_weights.find( entry.first ) == m_weights.end() )
+                    return false;
+            }
+
+            return true;
         }
 
-        inline bool accumulate_weight( bone_weights &results, const key_type &key, scalar modifier ) const
+        inline bool accumulate_weight( indexed_weights &results, const key_type &key, scalar modifier ) const
         {
             bool added_weights = false;
 
-            const bone_weights &weight_data = weights( key );
-            for( const auto &weight : weight_data )
+            auto found_weights = m_weights.find( key );
+            if( found_weights == m_weights.end() )
+                return false;
+
+            for( const auto &weight : found_weights->second )
             {
-                weight_finder finder( weight.first );
-                auto &found = find_if( results.begin(), results.end(), finder );
+                auto found = results.begin();
+                while( ( found != results.end() ) && ( found->first != weight.first ) )
+                {
+                    ++found;
+                }
+
                 if( found == results.end() )
                 {
                     results.emplace_back( weight );
@@ -491,7 +1254,28 @@ namespace vd
             return added_weights;
         }
 
-        inline bool clip_weights( bone_weights &results, scalar clip, bool normalize ) const
+        // Trim blended weights to total influences (clamped to M), then normalize and clip them
+        void finish_weights( indexed_weights &results, size_t total, scalar clip, bool normalize ) const
+        {
+            if( ( M > 0 ) && ( ( total == 0 ) || ( total > M ) ) )
+                total = M;
+
+            if( (total > 0) && (results.size() > total) )
+            {
+                VERTDB_BUCKET_SORTER( results.begin(), results.end(), indexed_weight_sort );
+                results.resize( total );
+            }
+
+            if( normalize )
+            {
+                normalize_weights( results );
+            }
+
+            clip_weights( results, clip, normalize );
+        }
+
+        template<typename W>
+        inline bool clip_weights( W &results, scalar clip, bool normalize ) const
         {
             bool did_clip = false;
 
@@ -516,7 +1300,8 @@ namespace vd
             return did_clip;
         }
 
-        static inline bool normalize_weights( bone_weights &weights )
+        template<typename W>
+        static inline bool normalize_weights( W &weights )
         {
             scalar sum = 0;
             for( const auto &weight : weights )
@@ -553,27 +1338,429 @@ namespace vd
         {
             m_manifest.emplace( key );
 
-            // Raw Data
+            // Retire the old entries in the acceleration structures before overwriting their sources
+            if( def.has_id() || def.has_connects() )
+                m_adjacency_valid = false;
+
+            if( def.has_id() )
+                retire_id( key );
+
+            if( def.has_position() && is_indexed( k_item_position ) )
+                move_in_cloud( m_pos_cloud, m_positions, key, def.position );
+
+            if( def.has_uvw() && is_indexed( k_item_uvw ) )
+                move_in_cloud( m_uvw_cloud, m_uvws, key, def.uvw );
+
+            if( def.has_color() && is_indexed( k_item_color ) )
+                move_in_cloud( m_color_cloud, m_colors, key, def.color );
+
+            apply_channels( key, def );
+
+            // Accelleration structures
+            if( def.has_id() && is_indexed( k_item_id ) )
+                index_id( key, def.id );
+        }
+
+        // Point id's directory entry at key.  Keys sharing an id resolve to the highest one,
+        //  as a rebuild walking keys in order would, and the directory remembers it holds duplicates.
+        void index_id( const key_type &key, const vert_id &id ) const
+        {
+            auto result = m_directory.emplace( id, key );
+            if( result.second )
+                return;
+
+            m_shared_ids = true;
+            if( result.first->second < key )
+                result.first->second = key;
+        }
+
+        // Drop key's directory entry, if the directory is built and still points at key.
+        //  Another key may hold the same id, so with duplicates the directory is released to rebuild instead.
+        void retire_id( const key_type &key )
+        {
+            if( !is_indexed( k_item_id ) )
+                return;
+
+            auto found = m_ids.find( key );
+            if( found == m_ids.end() )
+                return;
+
+            auto entry = m_directory.find( found->second );
+            if( ( entry == m_directory.end() ) || ( entry->second != key ) )
+                return;
+
+            if( m_shared_ids )
+                m_indexed &= ~static_cast<item_flags_backing>( k_item_id );
+            else
+                m_directory.erase( entry );
+        }
+
+        bool is_indexed( item_flags index ) const
+        {
+            return flag_is_set( static_cast<item_flags>( m_indexed.load() ), index );
+        }
+
+        // Free cloud if a batch is about to move more than 1/VERTDB_BATCH_REINDEX_DIVISOR of its points
+        void release_moved( cloud_type &cloud, item_flags index, size_t moved )
+        {
+            if( !is_indexed( index ) || ( moved * VERTDB_BATCH_REINDEX_DIVISOR <= cloud.count() ) )
+                return;
+
+            cloud.clear();
+            m_indexed &= ~static_cast<item_flags_backing>( index );
+        }
+
+        // Free every index; each is rebuilt in bulk by the next query that needs it
+        void release_indices()
+        {
+            m_pos_cloud.clear();
+            m_uvw_cloud.clear();
+            m_color_cloud.clear();
+
+            vert_directory empty;
+            m_directory.swap( empty );
+            m_shared_ids = false;
+
+            m_indexed = k_item_none;
+            m_adjacency_valid = false;
+        }
+
+        const cloud_type& position_index() const
+        {
+            return cloud_index( m_pos_cloud, m_positions, k_item_position );
+        }
+
+        const cloud_type& uvw_index() const
+        {
+            return cloud_index( m_uvw_cloud, m_uvws, k_item_uvw );
+        }
+
+        const cloud_type& color_index() const
+        {
+            return cloud_index( m_color_cloud, m_colors, k_item_color );
+        }
+
+        // Build cloud from every value in source the first time it is needed
+        const cloud_type& cloud_index( cloud_type &cloud, const point_storage &source, item_flags index ) const
+        {
+            if( is_indexed( index ) )
+                return cloud;
+
+            lock_type lock( m_index_mutex );
+            if( is_indexed( index ) )
+                return cloud;
+
+            rebuild_cloud( cloud, source );
+            if( m_auto_rebucket )
+                cloud.auto_rebucket();
+
+            m_indexed |= index;
+            return cloud;
+        }
+
+        const vert_directory& directory_index() const
+        {
+            if( is_indexed( k_item_id ) )
+                return m_directory;
+
+            lock_type lock( m_index_mutex );
+            if( is_indexed( k_item_id ) )
+                return m_directory;
+
+            // Walk keys in order so later duplicates win, as index_id resolves them
+            m_directory.clear();
+            m_shared_ids = false;
+            for( key_type key = 0; key < m_data.size(); ++key )
+            {
+                auto found = m_ids.find( key );
+                if( found != m_ids.end() )
+                    index_id( key, found->second );
+            }
+
+            m_indexed |= k_item_id;
+            return m_directory;
+        }
+
+        // Raw Data
+        void apply_channels( key_type key, const def_type &def )
+        {
             def.apply_id( key, m_ids );
             def.apply_position( key, m_positions );
             def.apply_normal( key,  m_normals );
             def.apply_uvw( key, m_uvws );
             def.apply_color( key, m_colors );
-            def.apply_weights( key, m_weights );
+            if( def.has_weights() )
+                m_bones.intern<M>( def.weights, m_weights[key] );
             def.apply_connects( key, m_connects );
+        }
+
+        // Index keys [first, m_data.size()) after a batch load, one structure per task.
+        //  A batch large enough that update_batch would release a cloud releases it here too,
+        //  so the next query rebuilds it in one bulk build instead of taking the batch point by point.
+        void finish_batch( key_type first )
+        {
+            m_adjacency_valid = false;
+
+            size_t added = m_data.size() - first;
+            release_moved( m_pos_cloud, k_item_position, added );
+            release_moved( m_uvw_cloud, k_item_uvw, added );
+            release_moved( m_color_cloud, k_item_color, added );
+
+            // Unbuilt indices stay that way until something queries them
+            VERTDB_BUCKET<batch_index> jobs;
+            if( is_indexed( k_item_position ) )
+                jobs.emplace_back( k_batch_position );
+
+            if( is_indexed( k_item_uvw ) )
+                jobs.emplace_back( k_batch_uvw );
+
+            if( is_indexed( k_item_color ) )
+                jobs.emplace_back( k_batch_color );
+
+            if( is_indexed( k_item_id ) )
+                jobs.emplace_back( k_batch_directory );
+
+            batch_index_func func{ *this, first };
+            key_collection unused;
+            batch_index_processor processor( func, jobs.begin(), jobs.end(), unused );
+            processor.join();
+
+            if( m_auto_rebucket && ( m_data.size() >= m_rebucket_at ) )
+            {
+                auto_rebucket();
+                m_rebucket_at = m_data.size() * 2;
+            }
+        }
+
+        static void insert_range( cloud_type &cloud, const point_storage &source, key_type first, key_type last )
+        {
+            for( key_type key = first; key < last; ++key )
+            {
+                auto found = source.find( key );
+                if( found != source.end() )
+                    cloud.insert( found->second, key );
+            }
+        }
+
+        enum batch_index
+        {
+            k_batch_position,
+            k_batch_uvw,
+            k_batch_color,
+            k_batch_directory,
+        };
+
+        // Each job touches a different structure, so they can run side by side
+        struct batch_index_func
+        {
+            void operator()( const batch_index &job, key_collection & ) const
+            {
+                key_type last = m_db.m_data.size();
+                switch( job )
+                {
+                case k_batch_position:
+                    insert_range( m_db.m_pos_cloud, m_db.m_positions, m_first, last );
+                    break;
+                case k_batch_uvw:
+                    insert_range( m_db.m_uvw_cloud, m_db.m_uvws, m_first, last );
+                    break;
+                case k_batch_color:
+                    insert_range( m_db.m_color_cloud, m_db.m_colors, m_first, last );
+                    break;
+                case k_batch_directory:
+                    for( key_type key = m_first; key < last; ++key )
+                    {
+                        auto found = m_db.m_ids.find( key );
+                        if( found != m_db.m_ids.end() )
+                            m_db.index_id( key, found->second );
+                    }
+                    break;
+                }
+            }
+
+            self_type &m_db;
+            key_type m_first;
+        };
+
+        typedef threaded_processor<batch_index_func, typename VERTDB_BUCKET<batch_index>::iterator, key_collection> batch_index_processor;
+
+        static void erase_from_cloud( cloud_type &cloud, const point_storage &source, const key_type &key )
+        {
+            auto found = source.find( key );
+            if( found != source.end() )
+                cloud.erase( found->second, key );
+        }
+
+        static void rebuild_cloud( cloud_type &cloud, const point_storage &source )
+        {
+            point_collection points;
+            key_collection keys;
+            points.reserve( source.size() );
+            keys.reserve( source.size() );
+            for( const auto &entry : source )
+            {
+                points.emplace_back( entry.second );
+                keys.emplace_back( entry.first );
+            }
+
+            cloud.build( points, keys );
+        }
+
+        // Move every value to its remapped key, dropping values whose key maps to c_invalid_vert_id
+        template<typename C>
+        static void compact_channel( C &channel, const key_collection &remap )
+        {
+            C compacted;
+            for( auto &&entry : channel )
+            {
+                if( ( entry.first < remap.size() ) && ( remap[entry.first] != c_invalid_vert_id ) )
+                    compacted[remap[entry.first]] = VERTDB_MOVE( entry.second );
+            }
+
+            channel = VERTDB_MOVE( compacted );
+        }
+
+        static inline size_t write_shard( const key_type &key )
+        {
+            // In-place writers under different shards must never share a presence mask word
+            static_assert( ( VERTDB_WRITE_SHARD_SPAN % dense_channel<key_type, point_type>::c_mask_bits ) == 0,
+                           "VERTDB_WRITE_SHARD_SPAN must be a multiple of the dense_channel mask word size" );
+
+            return ( static_cast<size_t>( key ) / VERTDB_WRITE_SHARD_SPAN ) % VERTDB_WRITE_SHARDS;
+        }
+
+        // Holds every write shard, for edits that insert into shared structures.
+        //  Shards are always taken in order, so exclusive edits queue behind each other on the first.
+        struct exclusive_edit
+        {
+            exclusive_edit( self_type &db )
+                : m_db( db )
+            {
+                for( auto &shard : m_db.m_write_shards )
+                    shard.lock();
+            }
+
+            ~exclusive_edit()
+            {
+                for( auto &shard : m_db.m_write_shards )
+                    shard.unlock();
+            }
+
+            self_type &m_db;
+        };
+
+        template<typename C>
+        static inline bool channel_in_place( const C &channel, const key_type &key )
+        {
+            return channel_traits<C>::in_place( channel, key );
+        }
+
+        // Extend every channel that holds values to count keys.
+        //  Channels nothing has written stay unallocated until their first write.
+        void extend_channels( size_t count )
+        {
+            extend_channel( m_ids, count );
+            extend_channel( m_positions, count );
+            extend_channel( m_normals, count );
+            extend_channel( m_uvws, count );
+            extend_channel( m_colors, count );
+            extend_channel( m_weights, count );
+            extend_channel( m_connects, count );
+        }
+
+        template<typename C>
+        static void extend_channel( C &channel, size_t count )
+        {
+            if( !channel.empty() )
+                channel_traits<C>::extend( channel, count );
+        }
+
+        // True if def only assigns existing storage for key, so it can be applied under key's write shard.
+        //  New keys, new bones, new channel slots and directory edits all need exclusive_edit.
+        bool writes_in_place( const key_type &key, const def_type &def ) const
+        {
+            if( ( key >= m_data.size() ) || ( m_manifest.find( key ) == m_manifest.end() ) )
+                return false;
+
+            if( def.has_id() && ( is_indexed( k_item_id ) || !channel_in_place( m_ids, key ) ) )
+                return false;
+
+            if( def.has_position() && !channel_in_place( m_positions, key ) )
+                return false;
+
+            if( def.has_normal() && !channel_in_place( m_normals, key ) )
+                return false;
+
+            if( def.has_uvw() && !channel_in_place( m_uvws, key ) )
+                return false;
+
+            if( def.has_color() && !channel_in_place( m_colors, key ) )
+                return false;
+
+            if( def.has_weights() && ( !channel_in_place( m_weights, key ) || !m_bones.contains( def.weights ) ) )
+                return false;
+
+            if( def.has_connects() && !channel_in_place( m_connects, key ) )
+                return false;
+
+            return true;
+        }
+
+        // apply_def for writes_in_place defs.  Built clouds are edited under their own lock,
+        //  so writers only contend when they move points in the same cloud.
+        void apply_in_place( const key_type &key, const def_type &def )
+        {
+            if( def.has_id() || def.has_connects() )
+                m_adjacency_valid = false;
+
+            if( def.has_position() && is_indexed( k_item_position ) )
+                move_in_cloud( m_pos_cloud, m_pos_cloud_mutex, m_positions, key, def.position );
+
+            if( def.has_uvw() && is_indexed( k_item_uvw ) )
+                move_in_cloud( m_uvw_cloud, m_uvw_cloud_mutex, m_uvws, key, def.uvw );
+
+            if( def.has_color() && is_indexed( k_item_color ) )
+                move_in_cloud( m_color_cloud, m_color_cloud_mutex, m_colors, key, def.color );
 
-            // Accelleration structures
             if( def.has_id() )
-                m_directory[def.id] = key;
+                channel_traits<id_storage>::slot( m_ids, key ) = def.id;
 
             if( def.has_position() )
-                m_pos_cloud.insert( def.position, key );
+                channel_traits<point_storage>::slot( m_positions, key ) = def.position;
+
+            if( def.has_normal() )
+                channel_traits<point_storage>::slot( m_normals, key ) = def.normal;
 
             if( def.has_uvw() )
-                m_uvw_cloud.insert( def.uvw, key );
+                channel_traits<point_storage>::slot( m_uvws, key ) = def.uvw;
 
             if( def.has_color() )
-                m_color_cloud.insert( def.color, key );
+                channel_traits<point_storage>::slot( m_colors, key ) = def.color;
+
+            if( def.has_weights() )
+                m_bones.intern<M>( def.weights, channel_traits<weights_storage>::slot( m_weights, key ) );
+
+            if( def.has_connects() )
+                channel_traits<connects_storage>::slot( m_connects, key ) = def.connects;
+        }
+
+        static void move_in_cloud( cloud_type &cloud, mutex_type &mutex, const point_storage &source, const key_type &key, const point_type &location )
+        {
+            lock_type lock( mutex );
+            move_in_cloud( cloud, source, key, location );
+        }
+
+        // Insert key into cloud at location, or move it there from where source last placed it
+        static void move_in_cloud( cloud_type &cloud, const point_storage &source, const key_type &key, const point_type &location )
+        {
+            auto found = source.find( key );
+            if( found == source.end() )
+            {
+                cloud.insert( location, key );
+                return;
+            }
+
+            cloud.move( found->second, location, key );
         }
 
         // Authoritative representation
@@ -581,23 +1768,48 @@ namespace vd
         vert_manifest m_manifest;
 
         // Remap from user keys to internal keys
-        vert_directory m_directory;
+        mutable vert_directory m_directory;
 
-        // Internal data storage (keys may be sparse)
+        // True once m_directory has seen two keys share an id, so retiring one cannot just erase the entry
+        mutable bool m_shared_ids;
+
+        // Internal data storage (one column per channel, indexed by key)
         id_storage m_ids;
         point_storage m_positions;
         point_storage m_normals;
         point_storage m_uvws;
         point_storage m_colors;
         weights_storage m_weights;
+
+        // Bone names behind the indices in m_weights
+        bone_palette m_bones;
         connects_storage m_connects;
 
         // Accelleration Structures
-        cloud_type m_pos_cloud;
-        cloud_type m_uvw_cloud;
-        cloud_type m_color_cloud;
+        // Built on first use, then kept current (see build_indices)
+        mutable cloud_type m_pos_cloud;
+        mutable cloud_type m_uvw_cloud;
+        mutable cloud_type m_color_cloud;
+        bool m_auto_rebucket;
+        size_t m_rebucket_at;
+
+        // Tombstoned keys in m_data, reclaimed by compact()
+        size_t m_erased;
+
+        // Item flags for the directory and clouds that are built
+        mutable VERTDB_ATOMIC<item_flags_backing> m_indexed;
+        mutable mutex_type m_index_mutex;
+
+        // Lazily compiled from m_connects and m_directory
+        mutable adjacency_type m_adjacency;
+        mutable VERTDB_ATOMIC<bool> m_adjacency_valid;
+        mutable mutex_type m_adjacency_mutex;
 
         // Parellelization
-        mutex_type m_mutex_edit;
+        //  update_atomic locks one shard per key range; structural edits hold every shard
+        mutex_type m_write_shards[VERTDB_WRITE_SHARDS];
+        mutex_type m_pos_cloud_mutex;
+        mutex_type m_uvw_cloud_mutex;
+        mutex_type m_color_cloud_mutex;
     };
 };
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "vert_db_config.h"
+#include "vert_db_types.h"
+
+namespace vd
+{
+    // Compressed sparse row adjacency: the neighbours of key k are
+    //  m_neighbours[m_offsets[k], m_offsets[k + 1]), already resolved to internal keys.
+    template<typename K>
+    class compiled_adjacency
+    {
+    public:
+        typedef K key_type;
+        typedef VERTDB_BUCKET<key_type> key_collection;
+        typedef VERTDB_BUCKET<size_t> offset_collection;
+
+        struct range
+        {
+            const key_type* begin() const
+            {
+                return m_begin;
+            }
+
+            const key_type* end() const
+            {
+                return m_end;
+            }
+
+            size_t size() const
+            {
+                return m_end - m_begin;
+            }
+
+            bool empty() const
+            {
+                return m_end == m_begin;
+            }
+
+            const key_type *m_begin;
+            const key_type *m_end;
+        };
+
+        compiled_adjacency()
+            : m_offsets()
+            , m_neighbours()
+        {
+        }
+
+        // Number of keys with a row, including ones without neighbours
+        size_t size() const
+        {
+            return m_offsets.empty() ? 0 : m_offsets.size() - 1;
+        }
+
+        size_t edge_count() const
+        {
+            return m_neighbours.size();
+        }
+
+        range neighbours( const key_type &key ) const
+        {
+            if( key >= size() )
+                return range{ nullptr, nullptr };
+
+            const key_type *data = m_neighbours.data();
+            return range{ data + m_offsets[key], data + m_offsets[key + 1] };
+        }
+
+        // Rebuild from row_func( key, neighbours ), which appends the neighbours of each key in [0, key_count)
+        template<typename F>
+        void build( size_t key_count, F row_func )
+        {
+            m_offsets.clear();
+            m_neighbours.clear();
+            m_offsets.reserve( key_count + 1 );
+
+            for( size_t key = 0; key < key_count; ++key )
+            {
+                m_offsets.emplace_back( m_neighbours.size() );
+                row_func( static_cast<key_type>( key ), m_neighbours );
+            }
+
+            m_offsets.emplace_back( m_neighbours.size() );
+        }
+
+        void clear()
+        {
+            m_offsets.clear();
+            m_neighbours.clear();
+        }
+
+    protected:
+        offset_collection m_offsets;
+        key_collection m_neighbours;
+    };
+
+    // Reusable visited marks for graph walks over keys.
+    //  Each walk bumps an epoch instead of clearing, so a key counts as visited
+    //  only if its stamp matches the current epoch.
+    template<typename K>
+    class traversal_context
+    {
+    public:
+        typedef K key_type;
+        typedef unsigned int stamp_type;
+        typedef VERTDB_ATOMIC<stamp_type> atomic_stamp;
+
+        traversal_context()
+            : m_stamps()
+            , m_capacity( 0 )
+            , m_epoch( 0 )
+        {
+        }
+
+        traversal_context( const traversal_context& ) = delete;
+        traversal_context& operator=( const traversal_context& ) = delete;
+
+        // Start a walk over keys [0, key_count)
+        void begin( size_t key_count )
+        {
+            if( key_count > m_capacity )
+                grow( key_count );
+
+            ++m_epoch;
+            if( m_epoch == 0 )
+            {
+                // Wrapped around, so old stamps could collide with new epochs
+                for( size_t i = 0; i < m_capacity; ++i )
+                {
+                    m_stamps[i].store( 0, VERTDB_MEMORY_RELAXED );
+                }
+
+                m_epoch = 1;
+            }
+        }
+
+        // Mark key, returning true if this walk had not visited it yet
+        bool visit( const key_type &key )
+        {
+            if( key >= m_capacity )
+                return false;
+
+            atomic_stamp &stamp = m_stamps[key];
+            if( stamp.load( VERTDB_MEMORY_RELAXED ) == m_epoch )
+                return false;
+
+            stamp.store( m_epoch, VERTDB_MEMORY_RELAXED );
+            return true;
+        }
+
+        // visit() that is safe to race with other threads claiming the same key
+        bool claim( const key_type &key )
+        {
+            if( key >= m_capacity )
+                return false;
+
+            atomic_stamp &stamp = m_stamps[key];
+            if( stamp.load( VERTDB_MEMORY_RELAXED ) == m_epoch )
+                return false;
+
+            return stamp.exchange( m_epoch, VERTDB_MEMORY_RELAXED ) != m_epoch;
+        }
+
+        bool visited( const key_type &key ) const
+        {
+            return ( key < m_capacity ) && ( m_stamps[key].load( VERTDB_MEMORY_RELAXED ) == m_epoch );
+        }
+
+    protected:
+        void grow( size_t key_count )
+        {
+            size_t capacity = ( m_capacity > 0 ) ? m_capacity : 64;
+            while( capacity < key_count )
+                capacity *= 2;
+
+            VERTDB_UNIQUE_PTR<atomic_stamp[]> stamps( new atomic_stamp[capacity] );
+            for( size_t i = 0; i < capacity; ++i )
+            {
+                stamp_type value = ( i < m_capacity ) ? m_stamps[i].load( VERTDB_MEMORY_RELAXED ) : 0;
+                stamps[i].store( value, VERTDB_MEMORY_RELAXED );
+            }
+
+            m_stamps = VERTDB_MOVE( stamps );
+            m_capacity = capacity;
+        }
+
+        VERTDB_UNIQUE_PTR<atomic_stamp[]> m_stamps;
+        size_t m_capacity;
+        stamp_type m_epoch;
+    };
+};
@@ -0,0 +1,294 @@
+#pragma once
+
+#include "vert_db_config.h"
+#include "vert_db_types.h"
+
+namespace vd
+{
+    // Skin weights for one vertex, stored inline with room for N influences.
+    //  Entries stay sorted by descending weight, and adding past capacity drops the smallest.
+    template<size_t N>
+    class inline_weights
+    {
+    public:
+        typedef inline_weights<N> self_type;
+        typedef indexed_weight value_type;
+        typedef value_type* iterator;
+        typedef const value_type* const_iterator;
+
+        static inline constexpr size_t capacity()
+        {
+            return N;
+        }
+
+        inline_weights()
+            : m_count( 0 )
+            , m_values()
+        {
+        }
+
+        size_t size() const
+        {
+            return m_count;
+        }
+
+        bool empty() const
+        {
+            return m_count == 0;
+        }
+
+        void clear()
+        {
+            m_count = 0;
+        }
+
+        iterator begin()
+        {
+            return m_values;
+        }
+
+        iterator end()
+        {
+            return m_values + m_count;
+        }
+
+        const_iterator begin() const
+        {
+            return m_values;
+        }
+
+        const_iterator end() const
+        {
+            return m_values + m_count;
+        }
+
+        const value_type& operator[]( size_t index ) const
+        {
+            return m_values[index];
+        }
+
+        // Add weight to bone index, merging with an existing entry for the same bone.
+        //  Returns false if the result was too small to keep.
+        bool add( bone_index index, VERTDB_BONEWEIGHT weight )
+        {
+            for( size_t i = 0; i < m_count; ++i )
+            {
+                if( m_values[i].first == index )
+                {
+                    weight += m_values[i].second;
+                    remove( i );
+                    break;
+                }
+            }
+
+            size_t slot = 0;
+            while( ( slot < m_count ) && ( m_values[slot].second >= weight ) )
+            {
+                ++slot;
+            }
+
+            if( slot >= N )
+                return false;
+
+            size_t last = ( m_count < N ) ? m_count : N - 1;
+            for( size_t i = last; i > slot; --i )
+            {
+                m_values[i] = m_values[i - 1];
+            }
+
+            m_values[slot] = value_type( index, weight );
+            if( m_count < N )
+                ++m_count;
+
+            return true;
+        }
+
+        bool operator==( const self_type &other ) const
+        {
+            if( m_count != other.m_count )
+                return false;
+
+            for( size_t i = 0; i < m_count; ++i )
+            {
+                if( m_values[i] != other.m_values[i] )
+                    return false;
+            }
+
+            return true;
+        }
+
+        bool operator!=( const self_type &other ) const
+        {
+            return !( *this == other );
+        }
+
+    protected:
+        void remove( size_t index )
+        {
+            for( size_t i = index + 1; i < m_count; ++i )
+            {
+                m_values[i - 1] = m_values[i];
+            }
+
+            --m_count;
+        }
+
+        size_t m_count;
+        value_type m_values[N];
+    };
+
+    // Per-vertex weight storage for an influence cap, where 0 means unlimited
+    template<size_t N>
+    struct weight_storage_traits
+    {
+        typedef inline_weights<N> storage_type;
+
+        static void add( storage_type &weights, bone_index index, VERTDB_BONEWEIGHT weight )
+        {
+            weights.add( index, weight );
+        }
+    };
+
+    template<>
+    struct weight_storage_traits<0>
+    {
+        typedef indexed_weights storage_type;
+
+        static void add( storage_type &weights, bone_index index, VERTDB_BONEWEIGHT weight )
+        {
+            weights.emplace_back( index, weight );
+        }
+    };
+
+    // Interns bone names into small dense indices.
+    //  vert_db stores weights against these indices and only converts to names at its API boundary.
+    class bone_palette
+    {
+    public:
+        typedef VERTDB_BONEID name_type;
+        typedef VERTDB_BUCKET<name_type> name_collection;
+        typedef VERTDB_MAP<name_type, bone_index> name_lookup;
+
+        static inline constexpr bone_index invalid_index()
+        {
+            return VERTDB_NUMERIC_LIMITS<bone_index>::max();
+        }
+
+        bone_palette()
+            : m_names()
+            , m_lookup()
+        {
+        }
+
+        size_t size() const
+        {
+            return m_names.size();
+        }
+
+        // Index for name, adding it if this palette has not seen it.
+        //  Returns invalid_index() once every index is taken.
+        bone_index intern( const name_type &name )
+        {
+            auto found = m_lookup.find( name );
+            if( found != m_lookup.end() )
+                return found->second;
+
+            if( m_names.size() >= invalid_index() )
+                return invalid_index();
+
+            bone_index index = static_cast<bone_index>( m_names.size() );
+            m_names.emplace_back( name );
+            m_lookup.emplace( name, index );
+            return index;
+        }
+
+        // Index for name without adding it, or invalid_index()
+        bone_index find( const name_type &name ) const
+        {
+            auto found = m_lookup.find( name );
+            if( found == m_lookup.end() )
+                return invalid_index();
+
+            return found->second;
+        }
+
+        // True if every bone in weights is already interned, so interning them will not grow the palette
+        bool contains( const bone_weights &weights ) const
+        {
+            for( const auto &weight : weights )
+            {
+                if( m_lookup.find( weight.first ) == m_lookup.end() )
+                    return false;
+            }
+
+            return true;
+        }
+
+        const name_type& name( bone_index index ) const
+        {
+            return m_names[index];
+        }
+
+        const name_collection& names() const
+        {
+            return m_names;
+        }
+
+        // Convert named weights to indexed weights, interning any new names
+        template<size_t N>
+        void intern( const bone_weights &weights, typename weight_storage_traits<N>::storage_type &results )
+        {
+            results.clear();
+            for( const auto &weight : weights )
+            {
+                bone_index index = intern( weight.first );
+                if( index != invalid_index() )
+                    weight_storage_traits<N>::add( results, index, weight.second );
+            }
+        }
+
+        void intern( const bone_weights &weights, indexed_weights &results )
+        {
+            intern<0>( weights, results );
+        }
+
+        template<typename W>
+        void resolve( const W &weights, bone_weights &results ) const
+        {
+            results.clear();
+            results.reserve( weights.size() );
+            for( const auto &weight : weights )
+            {
+                results.emplace_back( m_names[weight.first], weight.second );
+            }
+        }
+
+        template<typename W>
+        bone_weights resolve( const W &weights ) const
+        {
+            bone_weights results;
+            resolve( weights, results );
+            return results;
+        }
+
+        void clear()
+        {
+            m_names.clear();
+            m_lookup.clear();
+        }
+
+        bool operator==( const bone_palette &other ) const
+        {
+            return m_names == other.m_names;
+        }
+
+        bool operator!=( const bone_palette &other ) const
+        {
+            return !( *this == other );
+        }
+
+    protected:
+        name_collection m_names;
+        name_lookup m_lookup;
+    };
+};
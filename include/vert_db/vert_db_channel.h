@@ -0,0 +1,333 @@
+#pragma once
+
+#include "vert_db_config.h"
+#include "vert_db_types.h"
+
+namespace vd
+{
+    // Columnar storage for one vertex channel.
+    //  Keys handed out by vert_db are dense, so values live in a flat array indexed by key
+    //  alongside a presence bitmask.  Exposes the subset of the VERTDB_MAP interface that
+    //  db_item_def and vert_db rely on (operator[], find, end, erase, ==).
+    template<typename K, typename V>
+    class dense_channel
+    {
+    public:
+        typedef dense_channel<K, V> self_type;
+        typedef K key_type;
+        typedef V mapped_type;
+        typedef VERTDB_PAIR<const key_type, mapped_type&> reference;
+        typedef VERTDB_PAIR<const key_type, const mapped_type&> const_reference;
+
+        typedef VERTDB_DATA_STORAGE<mapped_type> value_collection;
+        typedef unsigned long long mask_word;
+        typedef VERTDB_DATA_STORAGE<mask_word> mask_collection;
+
+        static const size_t c_mask_bits = sizeof( mask_word ) * 8;
+
+        template<typename C, typename R>
+        class iterator_base
+        {
+        public:
+            typedef iterator_base<C, R> this_type;
+
+            // Lets iterator-> hand out a pair of references with map-like first/second
+            struct arrow_proxy
+            {
+                R* operator->()
+                {
+                    return &m_pair;
+                }
+
+                R m_pair;
+            };
+
+            iterator_base( C *channel, size_t index )
+                : m_channel( channel )
+                , m_index( index )
+            {
+                skip_absent();
+            }
+
+            R operator*() const
+            {
+                return R( static_cast<key_type>( m_index ), m_channel->m_values[m_index] );
+            }
+
+            arrow_proxy operator->() const
+            {
+                return arrow_proxy{ **this };
+            }
+
+            this_type& operator++()
+            {
+                ++m_index;
+                skip_absent();
+                return *this;
+            }
+
+            bool operator==( const this_type &other ) const
+            {
+                return m_index == other.m_index;
+            }
+
+            bool operator!=( const this_type &other ) const
+            {
+                return m_index != other.m_index;
+            }
+
+        protected:
+            void skip_absent()
+            {
+                size_t count = m_channel->m_values.size();
+                while( ( m_index < count ) && !m_channel->contains( m_index ) )
+                    ++m_index;
+            }
+
+            C *m_channel;
+            size_t m_index;
+        };
+
+        typedef iterator_base<self_type, reference> iterator;
+        typedef iterator_base<const self_type, const_reference> const_iterator;
+
+        dense_channel()
+            : m_values()
+            , m_present()
+            , m_count( 0 )
+        {
+        }
+
+        dense_channel( const self_type &other )
+            : m_values( other.m_values )
+            , m_present( other.m_present )
+            , m_count( other.m_count.load() )
+        {
+        }
+
+        dense_channel( self_type &&other )
+            : m_values( VERTDB_MOVE( other.m_values ) )
+            , m_present( VERTDB_MOVE( other.m_present ) )
+            , m_count( other.m_count.load() )
+        {
+            other.m_count = 0;
+        }
+
+        self_type& operator=( const self_type &other )
+        {
+            m_values = other.m_values;
+            m_present = other.m_present;
+            m_count = other.m_count.load();
+            return *this;
+        }
+
+        self_type& operator=( self_type &&other )
+        {
+            m_values = VERTDB_MOVE( other.m_values );
+            m_present = VERTDB_MOVE( other.m_present );
+            m_count = other.m_count.load();
+            other.m_count = 0;
+            return *this;
+        }
+
+        inline size_t size() const
+        {
+            return m_count;
+        }
+
+        inline bool empty() const
+        {
+            return m_count == 0;
+        }
+
+        inline size_t capacity() const
+        {
+            return m_values.size();
+        }
+
+        void reserve( size_t count )
+        {
+            m_values.reserve( count );
+            m_present.reserve( mask_words( count ) );
+        }
+
+        // Make room for keys below count without marking them present
+        void extend( size_t count )
+        {
+            if( count <= m_values.size() )
+                return;
+
+            m_values.resize( count );
+            m_present.resize( mask_words( count ), 0 );
+        }
+
+        void clear()
+        {
+            m_values.clear();
+            m_present.clear();
+            m_count = 0;
+        }
+
+        inline bool contains( const key_type &key ) const
+        {
+            size_t index = static_cast<size_t>( key );
+            if( index >= m_values.size() )
+                return false;
+
+            return ( m_present[index / c_mask_bits] & mask_bit( index ) ) != 0;
+        }
+
+        // Direct access for hot loops; caller guarantees the key is present
+        inline const mapped_type& at_unchecked( const key_type &key ) const
+        {
+            return m_values[static_cast<size_t>( key )];
+        }
+
+        mapped_type& operator[]( const key_type &key )
+        {
+            size_t index = static_cast<size_t>( key );
+            if( index >= m_values.size() )
+            {
+                m_values.resize( index + 1 );
+                m_present.resize( mask_words( index + 1 ), 0 );
+            }
+
+            mask_word &word = m_present[index / c_mask_bits];
+            if( ( word & mask_bit( index ) ) == 0 )
+            {
+                word |= mask_bit( index );
+                ++m_count;
+            }
+
+            return m_values[index];
+        }
+
+        size_t erase( const key_type &key )
+        {
+            if( !contains( key ) )
+                return 0;
+
+            size_t index = static_cast<size_t>( key );
+            m_present[index / c_mask_bits] &= ~mask_bit( index );
+            m_values[index] = mapped_type{};
+            --m_count;
+
+            return 1;
+        }
+
+        iterator find( const key_type &key )
+        {
+            return contains( key ) ? iterator( this, static_cast<size_t>( key ) ) : end();
+        }
+
+        const_iterator find( const key_type &key ) const
+        {
+            return contains( key ) ? const_iterator( this, static_cast<size_t>( key ) ) : end();
+        }
+
+        iterator begin()
+        {
+            return iterator( this, 0 );
+        }
+
+        iterator end()
+        {
+            return iterator( this, m_values.size() );
+        }
+
+        const_iterator begin() const
+        {
+            return const_iterator( this, 0 );
+        }
+
+        const_iterator end() const
+        {
+            return const_iterator( this, m_values.size() );
+        }
+
+        bool operator==( const self_type &other ) const
+        {
+            if( m_count != other.m_count.load() )
+                return false;
+
+            for( const auto &item : *this )
+            {
+                if( !other.contains( item.first ) )
+                    return false;
+
+                if( !( item.second == other.at_unchecked( item.first ) ) )
+                    return false;
+            }
+
+            return true;
+        }
+
+        bool operator!=( const self_type &other ) const
+        {
+            return !( *this == other );
+        }
+
+    protected:
+        static inline size_t mask_words( size_t count )
+        {
+            return ( count + c_mask_bits - 1 ) / c_mask_bits;
+        }
+
+        static inline mask_word mask_bit( size_t index )
+        {
+            return mask_word( 1 ) << ( index % c_mask_bits );
+        }
+
+        value_collection m_values;
+        mask_collection m_present;
+
+        // Atomic so writers to keys in different mask words can share a channel (see channel_traits)
+        VERTDB_ATOMIC<size_t> m_count;
+    };
+
+    // How vert_db writes a channel in place, without reshaping its storage.
+    //  Threads may write different keys concurrently as long as in_place() held for each of them.
+    template<typename C>
+    struct channel_traits
+    {
+        typedef typename C::key_type key_type;
+        typedef typename C::mapped_type mapped_type;
+
+        // Only existing entries can be assigned without inserting a node
+        static inline bool in_place( const C &channel, const key_type &key )
+        {
+            return channel.find( key ) != channel.end();
+        }
+
+        static inline mapped_type& slot( C &channel, const key_type &key )
+        {
+            return channel.find( key )->second;
+        }
+
+        static inline void extend( C &, size_t )
+        {
+        }
+    };
+
+    // Any key inside capacity() can be set; keys in different mask words touch disjoint memory
+    template<typename K, typename V>
+    struct channel_traits<dense_channel<K, V>>
+    {
+        typedef dense_channel<K, V> channel_type;
+
+        static inline bool in_place( const channel_type &channel, const K &key )
+        {
+            return static_cast<size_t>( key ) < channel.capacity();
+        }
+
+        static inline V& slot( channel_type &channel, const K &key )
+        {
+            return channel[key];
+        }
+
+        static inline void extend( channel_type &channel, size_t count )
+        {
+            channel.extend( count );
+        }
+    };
+};
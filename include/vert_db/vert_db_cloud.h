@@ -5,14 +5,194 @@
 #include "vert_db_item.h"
 #include "vert_db_utils.h"
 #include "vert_db_thread.h"
+#include "vert_db_simd.h"
 
 namespace vd
 {
+    // Results of many queries packed back to back.
+    //  Hits for query i are items[offsets[i]] up to items[offsets[i + 1]].
+    template<typename T>
+    struct batch_results
+    {
+        typedef T mapped_type;
+        typedef VERTDB_BUCKET<mapped_type> results_type;
+        typedef VERTDB_BUCKET<size_t> offset_collection;
+
+        offset_collection offsets;
+        results_type items;
+
+        inline size_t size() const
+        {
+            return offsets.empty() ? 0 : offsets.size() - 1;
+        }
+
+        inline size_t count( size_t query ) const
+        {
+            return offsets[query + 1] - offsets[query];
+        }
+
+        inline typename results_type::const_iterator begin( size_t query ) const
+        {
+            return items.begin() + offsets[query];
+        }
+
+        inline typename results_type::const_iterator end( size_t query ) const
+        {
+            return items.begin() + offsets[query + 1];
+        }
+    };
+
+    // Bucket occupancy summary for a spatial index
+    struct cloud_stats
+    {
+        typedef VERTDB_BUCKET<size_t> histogram_type;
+
+        size_t bucket_count{};
+        size_t point_count{};
+        size_t min_points{};
+        size_t max_points{};
+        real mean_points{};
+        real bucket_width{};
+
+        // histogram[i] counts buckets holding [2^i, 2^(i+1)) points
+        histogram_type histogram;
+    };
+
+    // Runs radius queries for a batch of locations on the thread pool.
+    //  Queries execute in ascending sort key order (such as a Morton code) so neighbouring
+    //  queries share warm cache lines, then hits are packed back into the original order.
+    //  C needs point_cloud's visit( location, radius, visitor ).
+    template<typename C>
+    class batch_query
+    {
+    public:
+        typedef typename C::mapped_type mapped_type;
+        typedef typename C::point_type point_type;
+        typedef typename C::scalar scalar;
+        typedef VERTDB_BUCKET<point_type> point_collection;
+        typedef VERTDB_BUCKET<unsigned long long> sort_key_collection;
+        typedef batch_results<mapped_type> batch_type;
+        typedef typename batch_type::results_type results_type;
+
+        static batch_type run( const C &cloud, const point_collection &locations, scalar radius, const sort_key_collection &sort_keys )
+        {
+            batch_type results;
+            size_t count = locations.size();
+            results.offsets.assign( count + 1, 0 );
+            if( count == 0 )
+                return results;
+
+            // Locality order
+            typedef VERTDB_PAIR<unsigned long long, size_t> order_pair;
+            VERTDB_BUCKET<order_pair> sorted;
+            sorted.reserve( count );
+            for( size_t i = 0; i < count; ++i )
+            {
+                sorted.emplace_back( sort_keys[i], i );
+            }
+            VERTDB_BUCKET_SORTER( sorted.begin(), sorted.end() );
+
+            index_collection order;
+            order.reserve( count );
+            for( const auto &pair : sorted )
+            {
+                order.emplace_back( pair.second );
+            }
+
+            range_collection ranges;
+            for( size_t start = 0; start < count; start += VERTDB_CLOUD_BATCH_CHUNK )
+            {
+                size_t stop = start + VERTDB_CLOUD_BATCH_CHUNK;
+                ranges.emplace_back( start, ( stop < count ) ? stop : count );
+            }
+
+            // Each chunk records its hits in sorted order
+            chunk_collection chunks;
+            batch_processor_func batch_runner{ cloud, locations, order, radius };
+            batch_processor processor( batch_runner, ranges.begin(), ranges.end(), chunks );
+            processor.join();
+
+            // Scatter counts back to query order, then pack
+            for( const auto &chunk : chunks )
+            {
+                for( size_t i = 0; i < chunk.m_counts.size(); ++i )
+                {
+                    results.offsets[order[chunk.m_begin + i] + 1] = chunk.m_counts[i];
+                }
+            }
+
+            for( size_t i = 0; i < count; ++i )
+            {
+                results.offsets[i + 1] += results.offsets[i];
+            }
+
+            results.items.resize( results.offsets[count] );
+            for( const auto &chunk : chunks )
+            {
+                auto hit = chunk.m_hits.begin();
+                for( size_t i = 0; i < chunk.m_counts.size(); ++i )
+                {
+                    size_t query = order[chunk.m_begin + i];
+                    auto stop = hit + chunk.m_counts[i];
+                    VERTDB_COPY( hit, stop, results.items.begin() + results.offsets[query] );
+                    hit = stop;
+                }
+            }
+
+            return results;
+        }
+
+    protected:
+        typedef VERTDB_BUCKET<size_t> index_collection;
+        typedef VERTDB_PAIR<size_t, size_t> index_range;
+        typedef VERTDB_BUCKET<index_range> range_collection;
+
+        // Hits for a contiguous run of the locality sorted queries
+        struct batch_chunk
+        {
+            size_t m_begin;
+            index_collection m_counts;
+            results_type m_hits;
+        };
+
+        typedef VERTDB_BUCKET<batch_chunk> chunk_collection;
+
+        struct batch_processor_func
+        {
+            void operator()( const index_range &range, chunk_collection &collector ) const
+            {
+                batch_chunk chunk;
+                chunk.m_begin = range.first;
+                chunk.m_counts.reserve( range.second - range.first );
+
+                for( size_t i = range.first; i < range.second; ++i )
+                {
+                    size_t before = chunk.m_hits.size();
+                    m_cloud.visit( m_locations[m_order[i]], m_radius, [&]( const mapped_type &item, scalar )
+                    {
+                        chunk.m_hits.emplace_back( item );
+                    } );
+
+                    chunk.m_counts.emplace_back( chunk.m_hits.size() - before );
+                }
+
+                collector.emplace_back( VERTDB_MOVE( chunk ) );
+            }
+
+            const C &m_cloud;
+            const point_collection &m_locations;
+            const index_collection &m_order;
+            scalar m_radius;
+        };
+
+        typedef threaded_processor<batch_processor_func, typename range_collection::iterator, chunk_collection> batch_processor;
+    };
+
     template<typename T, typename V = vec3, typename K = vec3i, typename S=real>
     class point_cloud
     {
     public:
-        typedef point_cloud<T, V, K> self_type;
+        typedef point_cloud<T, V, K, S> self_type;
         typedef T mapped_type;
         typedef V point_type;
         typedef K key_type;
@@ -20,11 +200,16 @@ namespace vd
 
         typedef VERTDB_BUCKET<mapped_type> results_type;
         typedef VERTDB_BUCKET<key_type> key_collection;
+        typedef VERTDB_BUCKET<point_type> point_collection;
+        typedef VERTDB_BUCKET<scalar> coordinate_collection;
+        typedef batch_results<mapped_type> batch_type;
+        typedef VERTDB_BUCKET<unsigned long long> sort_key_collection;
         typedef VERTDB_PAIR<point_type, mapped_type> bucket_value_type;
         typedef VERTDB_BUCKET<bucket_value_type> bucket_type;
 
         typedef VERTDB_MAP<key_type, bucket_type> bucket_map;
         typedef typename bucket_map::value_type map_pair;
+        typedef VERTDB_MAP<mapped_type, size_t> slot_map;
 
         typedef VERTDB_NUMERIC_LIMITS<scalar> limits_type;
 
@@ -33,9 +218,27 @@ namespace vd
             return limits_type::epsilon() * VERTDB_EPSILON_SCALE;
         }
 
+        static inline constexpr scalar unlimited()
+        {
+            return limits_type::max();
+        }
+
         point_cloud(scalar bucket_dim=1)
             : m_bucket_scale( width_to_scale(bucket_dim) )
+            , m_parallel_threshold( VERTDB_CLOUD_PARALLEL_CELLS )
+            , m_key_low()
+            , m_key_high()
+            , m_count( 0 )
             , m_data()
+            , m_slots()
+            , m_slots_valid( false )
+            , m_frozen( false )
+            , m_frozen_cell_count( 0 )
+            , m_frozen_cells()
+            , m_frozen_x()
+            , m_frozen_y()
+            , m_frozen_z()
+            , m_frozen_items()
         {
         }
 
@@ -43,9 +246,62 @@ namespace vd
         {
         }
 
-        size_t size()
+        // Number of occupied buckets
+        size_t size() const
+        {
+            return m_frozen ? m_frozen_cell_count : m_data.size();
+        }
+
+        // Number of stored points
+        size_t count() const
+        {
+            return m_count;
+        }
+
+        scalar bucket_width() const
+        {
+            return 1 / m_bucket_scale;
+        }
+
+        cloud_stats stats() const
         {
-            return m_data.size();
+            cloud_stats result;
+            result.bucket_count = size();
+            result.point_count = m_count;
+            result.bucket_width = bucket_width();
+
+            if( result.bucket_count == 0 )
+                return result;
+
+            result.min_points = VERTDB_NUMERIC_LIMITS<size_t>::max();
+            for_each_cell_size( [&]( size_t points )
+            {
+                result.min_points = ( points < result.min_points ) ? points : result.min_points;
+                result.max_points = ( points > result.max_points ) ? points : result.max_points;
+
+                size_t bin = 0;
+                while( ( points >> ( bin + 1 ) ) > 0 )
+                    ++bin;
+
+                if( bin >= result.histogram.size() )
+                    result.histogram.resize( bin + 1, 0 );
+
+                ++result.histogram[bin];
+            } );
+
+            result.mean_points = static_cast<real>( m_count ) / result.bucket_count;
+            return result;
+        }
+
+        // Queries touching fewer cells than this are scanned serially
+        inline size_t parallel_threshold() const
+        {
+            return m_parallel_threshold;
+        }
+
+        inline void set_parallel_threshold( size_t cell_count )
+        {
+            m_parallel_threshold = cell_count;
         }
 
         inline key_type key( const point_type &location ) const
@@ -75,7 +331,11 @@ namespace vd
 
         void insert( const point_type &location, const mapped_type &item )
         {
+            if( m_frozen )
+                thaw();
+
             key_type index = key( location );
+            expand_bounds( index );
 
             auto found = m_data.find( index );
             if( found == m_data.end() )
@@ -84,85 +344,960 @@ namespace vd
                 found = result.first;
             }
 
+            if( m_slots_valid )
+                m_slots[item] = found->second.size();
+
             found->second.emplace_back( location, item );
+            ++m_count;
+        }
+
+        // Drop every point, keeping the bucket width and tuning
+        void clear()
+        {
+            thaw();
+            m_data.clear();
+            clear_slots();
+            m_count = 0;
+            m_key_low = key_type{};
+            m_key_high = key_type{};
+        }
+
+        // Remove item, which must have been inserted at exactly location.
+        //  The location picks the cell and the slot index finds the item within it, so this is O(1)
+        //  on average.  The first erase or move after a build, thaw or clear indexes every item once.
+        bool erase( const point_type &location, const mapped_type &item )
+        {
+            if( m_frozen )
+                thaw();
+
+            auto found = m_data.find( key( location ) );
+            if( found == m_data.end() )
+                return false;
+
+            bucket_type &bucket = found->second;
+            size_t index = find_slot( bucket, item );
+            if( index == bucket.size() )
+                return false;
+
+            // Order within a bucket is not meaningful, so swap with the back
+            if( index + 1 != bucket.size() )
+            {
+                bucket[index] = VERTDB_MOVE( bucket.back() );
+                m_slots[bucket[index].second] = index;
+            }
+            bucket.pop_back();
+            m_slots.erase( item );
+
+            if( bucket.empty() )
+                m_data.erase( found );
+
+            --m_count;
+            return true;
+        }
+
+        // Relocate item from old_location to new_location, updating in place when the cell is unchanged.
+        //  Inserts at new_location if item was not found at old_location.  O(1) on average, like erase.
+        void move( const point_type &old_location, const point_type &new_location, const mapped_type &item )
+        {
+            if( m_frozen )
+                thaw();
+
+            key_type old_index = key( old_location );
+            key_type new_index = key( new_location );
+            if( old_index == new_index )
+            {
+                auto found = m_data.find( old_index );
+                if( found != m_data.end() )
+                {
+                    bucket_type &bucket = found->second;
+                    size_t index = find_slot( bucket, item );
+                    if( index != bucket.size() )
+                    {
+                        bucket[index].first = new_location;
+                        return;
+                    }
+                }
+            }
+            else
+            {
+                erase( old_location, item );
+            }
+
+            insert( new_location, item );
         }
 
         void rebucket( scalar bucket_width )
         {
-            // Store data
-            bucket_map temp( std::move( m_data ) );
+            bool was_frozen = m_frozen;
+
+            point_collection points;
+            results_type items;
+            extract( points, items );
 
-            // Reset structure
-            m_data.clear();
             m_bucket_scale = width_to_scale( bucket_width );
+            build( points, items );
+
+            if( was_frozen )
+                freeze();
+        }
+
+        // Replace the contents with items[i] at points[i].
+        //  Cell keys are computed and sorted in parallel, then every bucket is sized once and filled
+        //  from its run of the sorted order, so nothing is rehashed or regrown per point.
+        void build( const point_collection &points, const results_type &items )
+        {
+            clear();
+
+            size_t count = ( points.size() < items.size() ) ? points.size() : items.size();
+            if( count == 0 )
+                return;
+
+            range_collection ranges;
+            for( size_t start = 0; start < count; start += VERTDB_CLOUD_BUILD_CHUNK )
+            {
+                size_t stop = start + VERTDB_CLOUD_BUILD_CHUNK;
+                ranges.emplace_back( start, ( stop < count ) ? stop : count );
+            }
 
-            // Reinsert all the data
-            for( auto &bucket : temp )
+            // Key and sort each range on its own task
+            build_entry_collection entries( count );
+            index_collection unused;
+            build_key_func key_runner{ *this, points, entries };
+            build_processor key_processor( key_runner, ranges.begin(), ranges.end(), unused );
+            key_processor.join();
+
+            // Merge neighbouring ranges pairwise until one sorted run remains
+            while( ranges.size() > 1 )
             {
-                for( auto &pair : bucket.second )
+                range_collection merged;
+                VERTDB_BUCKET<merge_pair> pairs;
+                for( size_t i = 0; i < ranges.size(); i += 2 )
                 {
-                    key_type index = key( pair.first );
-                    auto found = m_data.find( index );
-                    if( found == m_data.end() )
+                    if( i + 1 < ranges.size() )
                     {
-                        auto result = m_data.emplace( map_pair( index, {} ) );
-                        found = result.first;
+                        pairs.emplace_back( merge_pair{ ranges[i].first, ranges[i].second, ranges[i + 1].second } );
+                        merged.emplace_back( ranges[i].first, ranges[i + 1].second );
                     }
+                    else
+                    {
+                        merged.emplace_back( ranges[i] );
+                    }
+                }
+
+                build_merge_func merge_runner{ entries };
+                build_merge_processor processor( merge_runner, pairs.begin(), pairs.end(), unused );
+                processor.join();
+
+                ranges.swap( merged );
+            }
+
+            // Size each bucket exactly, then fill buckets independently
+            range_collection runs;
+            for( size_t start = 0; start < count; )
+            {
+                size_t stop = start + 1;
+                while( ( stop < count ) && ( entries[stop].m_key == entries[start].m_key ) )
+                    ++stop;
+
+                runs.emplace_back( start, stop );
+                start = stop;
+            }
+
+            m_data.reserve( runs.size() );
+            bucket_collection buckets;
+            buckets.reserve( runs.size() );
+            for( const auto &run : runs )
+            {
+                const key_type &index = entries[run.first].m_key;
+                expand_bounds( index );
+
+                bucket_type &bucket = m_data[index];
+                bucket.reserve( run.second - run.first );
+                buckets.emplace_back( &bucket );
+            }
+
+            index_collection run_indices( runs.size() );
+            VERTDB_IOTA( run_indices.begin(), run_indices.end(), 0 );
+            build_fill_func fill_runner{ points, items, entries, runs, buckets };
+            build_fill_processor fill_processor( fill_runner, run_indices.begin(), run_indices.end(), unused );
+            fill_processor.join();
+
+            m_count = count;
+        }
+
+        bool frozen() const
+        {
+            return m_frozen;
+        }
+
+        // Pack every bucket into one contiguous run per cell for read-mostly use.
+        //  Cells are laid out in Z-order with each coordinate and the payloads in separate arrays,
+        //  and found through an open addressing table instead of the bucket map.
+        //  The next insert converts back to the mutable layout.
+        void freeze()
+        {
+            if( m_frozen )
+                return;
+
+            typedef VERTDB_PAIR<unsigned long long, const map_pair*> order_pair;
+            VERTDB_BUCKET<order_pair> order;
+            order.reserve( m_data.size() );
+            for( const auto &bucket : m_data )
+            {
+                order.emplace_back( morton_code( bucket.first ), &bucket );
+            }
+
+            VERTDB_BUCKET_SORTER( order.begin(), order.end(), []( const order_pair &a, const order_pair &b )
+            {
+                return a.first < b.first;
+            } );
+
+            size_t table_size = 1;
+            while( table_size < order.size() * 2 )
+                table_size <<= 1;
+
+            m_frozen_cells.assign( table_size, frozen_cell{} );
+            m_frozen_x.clear();
+            m_frozen_y.clear();
+            m_frozen_z.clear();
+            m_frozen_items.clear();
+            m_frozen_x.reserve( m_count );
+            m_frozen_y.reserve( m_count );
+            m_frozen_z.reserve( m_count );
+            m_frozen_items.reserve( m_count );
+
+            for( const auto &entry : order )
+            {
+                const map_pair &bucket = *entry.second;
+
+                frozen_cell cell{ bucket.first, m_frozen_items.size(), 0 };
+                for( const auto &item : bucket.second )
+                {
+                    m_frozen_x.emplace_back( item.first.x );
+                    m_frozen_y.emplace_back( item.first.y );
+                    m_frozen_z.emplace_back( item.first.z );
+                    m_frozen_items.emplace_back( item.second );
+                }
+                cell.m_end = m_frozen_items.size();
 
-                    found->second.emplace_back( std::move(pair) );
+                size_t mask = table_size - 1;
+                size_t slot = std::hash<key_type>()( cell.m_key ) & mask;
+                while( m_frozen_cells[slot].m_end != m_frozen_cells[slot].m_begin )
+                {
+                    slot = ( slot + 1 ) & mask;
                 }
+
+                m_frozen_cells[slot] = cell;
             }
+
+            m_frozen_cell_count = order.size();
+            m_frozen = true;
+
+            bucket_map empty;
+            m_data.swap( empty );
+            clear_slots();
         }
 
-        results_type find_bucket( const point_type& location, scalar radius, const key_type &key ) const
+        // Return to the mutable bucket map layout
+        void thaw()
         {
-            results_type results;
+            if( !m_frozen )
+                return;
 
-            scalar rad_sq = radius * radius;
+            m_data.clear();
+            m_data.reserve( m_frozen_cell_count );
+            clear_slots();
+            for( const auto &cell : m_frozen_cells )
+            {
+                if( cell.m_end == cell.m_begin )
+                    continue;
+
+                bucket_type &bucket = m_data[cell.m_key];
+                bucket.reserve( cell.m_end - cell.m_begin );
+                for( size_t i = cell.m_begin; i < cell.m_end; ++i )
+                {
+                    bucket.emplace_back( frozen_point( i ), m_frozen_items[i] );
+                }
+            }
+
+            m_frozen = false;
+            m_frozen_cell_count = 0;
 
-            auto found = m_data.find( key );
-            if( found != m_data.end() )
+            frozen_table empty_cells;
+            coordinate_collection empty_x;
+            coordinate_collection empty_y;
+            coordinate_collection empty_z;
+            results_type empty_items;
+            m_frozen_cells.swap( empty_cells );
+            m_frozen_x.swap( empty_x );
+            m_frozen_y.swap( empty_y );
+            m_frozen_z.swap( empty_z );
+            m_frozen_items.swap( empty_items );
+        }
+
+        // Pick a bucket width from point density so occupied buckets hold about target_points each.
+        //  Starts from the bounding box volume, then corrects once from the measured occupancy
+        //  because mesh vertices lie on surfaces rather than filling the box.
+        void auto_rebucket( size_t target_points = VERTDB_CLOUD_TARGET_OCCUPANCY )
+        {
+            if( ( m_count == 0 ) || ( target_points == 0 ) )
+                return;
+
+            bool was_frozen = m_frozen;
+            thaw();
+
+            point_type low{};
+            point_type high{};
+            bool first = true;
+            for( const auto &bucket : m_data )
             {
-                const auto& bucket = found->second;
-                for( const auto& item : bucket )
+                for( const auto &item : bucket.second )
                 {
-                    V between = location - item.first;
-                    scalar dist_sq = dot( between, between );
-                    if( dist_sq <= rad_sq )
+                    const point_type &point = item.first;
+                    if( first )
                     {
-                        results.emplace_back( item.second );
+                        low = point;
+                        high = point;
+                        first = false;
+                        continue;
                     }
+
+                    low = point_type{ ( point.x < low.x ) ? point.x : low.x, ( point.y < low.y ) ? point.y : low.y, ( point.z < low.z ) ? point.z : low.z };
+                    high = point_type{ ( point.x > high.x ) ? point.x : high.x, ( point.y > high.y ) ? point.y : high.y, ( point.z > high.z ) ? point.z : high.z };
                 }
             }
 
+            point_type extent = high - low;
+            scalar largest = ( extent.x > extent.y ) ? extent.x : extent.y;
+            largest = ( extent.z > largest ) ? extent.z : largest;
+            if( largest <= 0 )
+            {
+                if( was_frozen )
+                    freeze();
+                return;
+            }
+
+            // Flat or linear data shouldn't collapse the volume estimate to zero
+            scalar floor_extent = largest * scalar( 1e-3 );
+            scalar volume = ( ( extent.x > floor_extent ) ? extent.x : floor_extent )
+                          * ( ( extent.y > floor_extent ) ? extent.y : floor_extent )
+                          * ( ( extent.z > floor_extent ) ? extent.z : floor_extent );
+
+            scalar width = std::cbrt( volume * target_points / m_count );
+            rebucket( width );
+
+            scalar mean_points = static_cast<scalar>( m_count ) / m_data.size();
+            if( mean_points > 0 )
+            {
+                rebucket( width * sqrt( target_points / mean_points ) );
+            }
+
+            if( was_frozen )
+                freeze();
+        }
+
+        results_type find_bucket( const point_type& location, scalar radius, const key_type &key ) const
+        {
+            results_type results;
+            find_bucket( location, radius, key, results );
             return results;
         }
 
+        // Appends matches in one bucket to results
+        void find_bucket( const point_type& location, scalar radius, const key_type &key, results_type &results ) const
+        {
+            auto collector = [&]( const mapped_type &item, scalar )
+            {
+                results.emplace_back( item );
+            };
+
+            visit_bucket( location, radius * radius, key, collector );
+        }
+
         results_type find( const point_type &location, scalar radius=epsilon() ) const
         {
             results_type results;
-            key_collection keys = grid_keys( location, radius );
+            find( location, radius, results );
+            return results;
+        }
+
+        // Fills results with matches, reusing its storage between queries
+        void find( const point_type &location, scalar radius, results_type &results ) const
+        {
+            results.clear();
+
+            point_type half_size;
+            splat( half_size, radius );
+            key_type low = key( location - half_size );
+            key_type high = key( location + half_size );
+
+            if( cell_count( low, high ) < m_parallel_threshold )
+            {
+                visit( location, radius, [&]( const mapped_type &item, scalar )
+                {
+                    results.emplace_back( item );
+                } );
+
+                return;
+            }
+
+            key_collection keys = flood( low, high );
 
             bucket_processor_func bucket_runner{ *this, location, radius };
             bucket_processor processor( bucket_runner, keys.begin(), keys.end(), results );
             processor.join();
+        }
+
+        // Calls visitor( item, distance_squared ) for every match, on the calling thread
+        template<typename F>
+        void visit( const point_type &location, scalar radius, F visitor ) const
+        {
+            point_type half_size;
+            splat( half_size, radius );
+            scalar rad_sq = radius * radius;
+
+            for_each_cell( key( location - half_size ), key( location + half_size ), [&]( const key_type &cell )
+            {
+                visit_bucket( location, rad_sq, cell, visitor );
+            } );
+        }
+
+        // Radius query for every point in locations.
+        //  Queries run in Z-order of their cells so neighbouring queries share warm buckets,
+        //  and chunks of the sorted order are spread over the thread pool.
+        batch_type find_batch( const point_collection &locations, scalar radius ) const
+        {
+            sort_key_collection sort_keys;
+            sort_keys.reserve( locations.size() );
+            for( const auto &location : locations )
+            {
+                sort_keys.emplace_back( morton_code( key( location ) ) );
+            }
+
+            return batch_query<self_type>::run( *this, locations, radius, sort_keys );
+        }
+
+        // Closest item to location within max_radius.  Returns false if nothing was in range.
+        bool find_nearest( const point_type &location, mapped_type &result, scalar max_radius=unlimited() ) const
+        {
+            return find_nearest( location, result, max_radius, accept_all() );
+        }
+
+        // Closest item to location within max_radius that also satisfies predicate( item )
+        template<typename P>
+        bool find_nearest( const point_type &location, mapped_type &result, scalar max_radius, P predicate ) const
+        {
+            results_type found = find_k_nearest( location, 1, max_radius, predicate );
+            if( found.empty() )
+                return false;
+
+            result = found.front();
+            return true;
+        }
+
+        // Up to count items closest to location within max_radius, nearest first
+        results_type find_k_nearest( const point_type &location, size_t count, scalar max_radius=unlimited() ) const
+        {
+            return find_k_nearest( location, count, max_radius, accept_all() );
+        }
+
+        template<typename P>
+        results_type find_k_nearest( const point_type &location, size_t count, scalar max_radius, P predicate ) const
+        {
+            results_type results;
+            if( ( count == 0 ) || ( m_count == 0 ) )
+                return results;
+
+            candidate_collection best;
+            best.reserve( count + 1 );
+
+            scalar limit_sq = ( max_radius < unlimited() ) ? max_radius * max_radius : unlimited();
+            scalar width = 1 / m_bucket_scale;
+
+            key_type center = key( location );
+            scalar margin = cell_margin( location, center, width );
+            int_t last_shell = shell_extent( center );
+
+            // Grow outward one ring of cells at a time
+            for( int_t shell = 0; shell <= last_shell; ++shell )
+            {
+                if( shell > 0 )
+                {
+                    // Closest any point in this ring can be to location
+                    scalar reach = margin + ( shell - 1 ) * width;
+                    scalar reach_sq = reach * reach;
+
+                    if( reach_sq > limit_sq )
+                        break;
+
+                    if( ( best.size() == count ) && ( reach_sq >= best.front().first ) )
+                        break;
+                }
+
+                visit_shell( center, shell, [&]( const point_type &point, const mapped_type &item )
+                {
+                    V between = location - point;
+                    scalar dist_sq = dot( between, between );
+                    if( dist_sq > limit_sq )
+                        return;
+
+                    if( ( best.size() == count ) && ( dist_sq >= best.front().first ) )
+                        return;
+
+                    if( !predicate( item ) )
+                        return;
+
+                    best.emplace_back( dist_sq, item );
+                    VERTDB_HEAP_PUSH( best.begin(), best.end(), candidate_less() );
+
+                    if( best.size() > count )
+                    {
+                        VERTDB_HEAP_POP( best.begin(), best.end(), candidate_less() );
+                        best.pop_back();
+                    }
+                } );
+            }
+
+            VERTDB_HEAP_SORTER( best.begin(), best.end(), candidate_less() );
+
+            results.reserve( best.size() );
+            for( const auto &candidate : best )
+            {
+                results.emplace_back( candidate.second );
+            }
 
             return results;
         }
 
     protected:
+        typedef VERTDB_PAIR<scalar, mapped_type> candidate_type;
+        typedef VERTDB_BUCKET<candidate_type> candidate_collection;
+        typedef VERTDB_BUCKET<size_t> index_collection;
+        typedef VERTDB_PAIR<size_t, size_t> index_range;
+        typedef VERTDB_BUCKET<index_range> range_collection;
+
+        // Slot in the frozen cell table; empty slots have m_begin == m_end
+        struct frozen_cell
+        {
+            key_type m_key;
+            size_t m_begin;
+            size_t m_end;
+        };
+
+        typedef VERTDB_BUCKET<frozen_cell> frozen_table;
+
+        struct candidate_less
+        {
+            bool operator()( const candidate_type &a, const candidate_type &b ) const
+            {
+                return a.first < b.first;
+            }
+        };
+
+        struct accept_all
+        {
+            bool operator()( const mapped_type & ) const
+            {
+                return true;
+            }
+        };
 
         scalar width_to_scale( scalar bucket_dim ) const
         {
             return ( bucket_dim == 0 ) ? epsilon() : 1 / bucket_dim;
         }
 
+        void expand_bounds( const key_type &index )
+        {
+            if( m_data.empty() )
+            {
+                m_key_low = index;
+                m_key_high = index;
+                return;
+            }
+
+            m_key_low = key_type{ ( index.x < m_key_low.x ) ? index.x : m_key_low.x,
+                                  ( index.y < m_key_low.y ) ? index.y : m_key_low.y,
+                                  ( index.z < m_key_low.z ) ? index.z : m_key_low.z };
+
+            m_key_high = key_type{ ( index.x > m_key_high.x ) ? index.x : m_key_high.x,
+                                   ( index.y > m_key_high.y ) ? index.y : m_key_high.y,
+                                   ( index.z > m_key_high.z ) ? index.z : m_key_high.z };
+        }
+
+        // Distance from location to the nearest face of its own cell
+        scalar cell_margin( const point_type &location, const key_type &center, scalar width ) const
+        {
+            scalar margins[] = {
+                location.x - center.x * width, ( center.x + 1 ) * width - location.x,
+                location.y - center.y * width, ( center.y + 1 ) * width - location.y,
+                location.z - center.z * width, ( center.z + 1 ) * width - location.z,
+            };
+
+            scalar margin = margins[0];
+            for( scalar value : margins )
+            {
+                if( value < margin )
+                    margin = value;
+            }
+
+            return ( margin > 0 ) ? margin : 0;
+        }
+
+        // Ring index past which no occupied cell exists
+        int_t shell_extent( const key_type &center ) const
+        {
+            int_t extents[] = {
+                center.x - m_key_low.x, m_key_high.x - center.x,
+                center.y - m_key_low.y, m_key_high.y - center.y,
+                center.z - m_key_low.z, m_key_high.z - center.z,
+            };
+
+            int_t extent = 0;
+            for( int_t value : extents )
+            {
+                if( value > extent )
+                    extent = value;
+            }
+
+            return extent;
+        }
+
+        // Calls func( point, item ) for everything exactly shell cells away from center
+        template<typename F>
+        void visit_shell( const key_type &center, int_t shell, F func ) const
+        {
+            int_t low_x = ( center.x - shell > m_key_low.x ) ? center.x - shell : m_key_low.x;
+            int_t low_y = ( center.y - shell > m_key_low.y ) ? center.y - shell : m_key_low.y;
+            int_t high_x = ( center.x + shell < m_key_high.x ) ? center.x + shell : m_key_high.x;
+            int_t high_y = ( center.y + shell < m_key_high.y ) ? center.y + shell : m_key_high.y;
+
+            for( int_t x = low_x; x <= high_x; ++x )
+            {
+                for( int_t y = low_y; y <= high_y; ++y )
+                {
+                    bool edge = ( abs( x - center.x ) == shell ) || ( abs( y - center.y ) == shell );
+                    if( edge )
+                    {
+                        // Whole column lies on the ring
+                        int_t low_z = ( center.z - shell > m_key_low.z ) ? center.z - shell : m_key_low.z;
+                        int_t high_z = ( center.z + shell < m_key_high.z ) ? center.z + shell : m_key_high.z;
+
+                        for( int_t z = low_z; z <= high_z; ++z )
+                        {
+                            for_each_in_cell( key_type{ x, y, z }, func );
+                        }
+                    }
+                    else
+                    {
+                        // Interior columns only touch the ring at both ends
+                        for_each_in_cell( key_type{ x, y, center.z - shell }, func );
+                        for_each_in_cell( key_type{ x, y, center.z + shell }, func );
+                    }
+                }
+            }
+        }
+
+        template<typename F>
+        inline void visit_bucket( const point_type &location, scalar rad_sq, const key_type &key, F &visitor ) const
+        {
+            if( m_frozen )
+            {
+                const frozen_cell *cell = find_frozen( key );
+                if( cell != nullptr )
+                    visit_frozen( location, rad_sq, *cell, visitor );
+
+                return;
+            }
+
+            for_each_in_cell( key, [&]( const point_type &point, const mapped_type &item )
+            {
+                V between = location - point;
+                scalar dist_sq = dot( between, between );
+                if( dist_sq <= rad_sq )
+                {
+                    visitor( item, dist_sq );
+                }
+            } );
+        }
+
+        // Distance test a frozen cell in blocks with the vector kernel, then report the hits
+        template<typename F>
+        inline void visit_frozen( const point_type &location, scalar rad_sq, const frozen_cell &cell, F &visitor ) const
+        {
+            const size_t block_size = 64;
+            size_t hits[block_size];
+            scalar dist_sq[block_size];
+
+            for( size_t begin = cell.m_begin; begin < cell.m_end; begin += block_size )
+            {
+                size_t count = ( cell.m_end - begin < block_size ) ? cell.m_end - begin : block_size;
+                size_t found = radius_kernel<scalar>::filter(
+                    &m_frozen_x[begin], &m_frozen_y[begin], &m_frozen_z[begin], count,
+                    location.x, location.y, location.z, rad_sq, hits, dist_sq );
+
+                for( size_t i = 0; i < found; ++i )
+                {
+                    visitor( m_frozen_items[begin + hits[i]], dist_sq[i] );
+                }
+            }
+        }
+
+        inline point_type frozen_point( size_t index ) const
+        {
+            return point_type{ m_frozen_x[index], m_frozen_y[index], m_frozen_z[index] };
+        }
+
+        // Calls func( point, item ) for everything stored in one cell, in either storage layout
+        template<typename F>
+        inline void for_each_in_cell( const key_type &index, F &&func ) const
+        {
+            if( m_frozen )
+            {
+                const frozen_cell *cell = find_frozen( index );
+                if( cell == nullptr )
+                    return;
+
+                for( size_t i = cell->m_begin; i < cell->m_end; ++i )
+                {
+                    func( frozen_point( i ), m_frozen_items[i] );
+                }
+
+                return;
+            }
+
+            auto found = m_data.find( index );
+            if( found == m_data.end() )
+                return;
+
+            for( const auto &item : found->second )
+            {
+                func( item.first, item.second );
+            }
+        }
+
+        // Calls func( point_count ) for every occupied cell
+        template<typename F>
+        void for_each_cell_size( F func ) const
+        {
+            if( m_frozen )
+            {
+                for( const auto &cell : m_frozen_cells )
+                {
+                    if( cell.m_end > cell.m_begin )
+                        func( cell.m_end - cell.m_begin );
+                }
+
+                return;
+            }
+
+            for( const auto &bucket : m_data )
+            {
+                func( bucket.second.size() );
+            }
+        }
+
+        static inline size_t find_in_bucket( const bucket_type &bucket, const mapped_type &item )
+        {
+            size_t index = 0;
+            for( ; index < bucket.size(); ++index )
+            {
+                if( bucket[index].second == item )
+                    break;
+            }
+
+            return index;
+        }
+
+        // Slot of item in bucket from the slot index, building the index first if needed.
+        //  An item stored more than once only indexes its latest slot, so a miss falls back to a scan.
+        size_t find_slot( const bucket_type &bucket, const mapped_type &item )
+        {
+            index_slots();
+
+            auto found = m_slots.find( item );
+            if( ( found != m_slots.end() ) && ( found->second < bucket.size() ) && ( bucket[found->second].second == item ) )
+                return found->second;
+
+            return find_in_bucket( bucket, item );
+        }
+
+        void index_slots()
+        {
+            if( m_slots_valid )
+                return;
+
+            m_slots.clear();
+            m_slots.reserve( m_count );
+            for( const auto &bucket : m_data )
+            {
+                for( size_t i = 0; i < bucket.second.size(); ++i )
+                {
+                    m_slots[bucket.second[i].second] = i;
+                }
+            }
+
+            m_slots_valid = true;
+        }
+
+        // Bulk layout changes drop the slot index rather than keeping it current
+        void clear_slots()
+        {
+            slot_map empty;
+            m_slots.swap( empty );
+            m_slots_valid = false;
+        }
+
+        // Copy out every point and item, in either storage layout
+        void extract( point_collection &points, results_type &items ) const
+        {
+            points.clear();
+            items.clear();
+            points.reserve( m_count );
+            items.reserve( m_count );
+
+            for_each_cell_key( [&]( const key_type &index )
+            {
+                for_each_in_cell( index, [&]( const point_type &point, const mapped_type &item )
+                {
+                    points.emplace_back( point );
+                    items.emplace_back( item );
+                } );
+            } );
+        }
+
+        // Calls func( key ) for every occupied cell
+        template<typename F>
+        void for_each_cell_key( F func ) const
+        {
+            if( m_frozen )
+            {
+                for( const auto &cell : m_frozen_cells )
+                {
+                    if( cell.m_end > cell.m_begin )
+                        func( cell.m_key );
+                }
+
+                return;
+            }
+
+            for( const auto &bucket : m_data )
+            {
+                func( bucket.first );
+            }
+        }
+
+        struct build_entry
+        {
+            unsigned long long m_code;
+            key_type m_key;
+            size_t m_index;
+        };
+
+        typedef VERTDB_BUCKET<build_entry> build_entry_collection;
+        typedef VERTDB_BUCKET<bucket_type*> bucket_collection;
+
+        // Z-order, with the key itself breaking ties between cells outside morton_code's range
+        static inline bool build_entry_less( const build_entry &a, const build_entry &b )
+        {
+            if( a.m_code != b.m_code )
+                return a.m_code < b.m_code;
+
+            if( a.m_key.x != b.m_key.x )
+                return a.m_key.x < b.m_key.x;
+
+            if( a.m_key.y != b.m_key.y )
+                return a.m_key.y < b.m_key.y;
+
+            return a.m_key.z < b.m_key.z;
+        }
+
+        struct build_key_func
+        {
+            void operator()( const index_range &range, index_collection & ) const
+            {
+                for( size_t i = range.first; i < range.second; ++i )
+                {
+                    key_type index = m_cloud.key( m_points[i] );
+                    m_entries[i] = build_entry{ morton_code( index ), index, i };
+                }
+
+                VERTDB_BUCKET_SORTER( m_entries.begin() + range.first, m_entries.begin() + range.second, build_entry_less );
+            }
+
+            const self_type &m_cloud;
+            const point_collection &m_points;
+            build_entry_collection &m_entries;
+        };
+
+        // Two adjacent sorted runs [m_begin, m_middle) and [m_middle, m_end)
+        struct merge_pair
+        {
+            size_t m_begin;
+            size_t m_middle;
+            size_t m_end;
+        };
+
+        struct build_merge_func
+        {
+            void operator()( const merge_pair &pair, index_collection & ) const
+            {
+                VERTDB_BUCKET_MERGER( m_entries.begin() + pair.m_begin, m_entries.begin() + pair.m_middle, m_entries.begin() + pair.m_end, build_entry_less );
+            }
+
+            build_entry_collection &m_entries;
+        };
+
+        struct build_fill_func
+        {
+            void operator()( const size_t &run_index, index_collection & ) const
+            {
+                const index_range &run = m_runs[run_index];
+                bucket_type &bucket = *m_buckets[run_index];
+                for( size_t i = run.first; i < run.second; ++i )
+                {
+                    size_t source = m_entries[i].m_index;
+                    bucket.emplace_back( m_points[source], m_items[source] );
+                }
+            }
+
+            const point_collection &m_points;
+            const results_type &m_items;
+            const build_entry_collection &m_entries;
+            const range_collection &m_runs;
+            const bucket_collection &m_buckets;
+        };
+
+        typedef threaded_processor<build_key_func, typename range_collection::iterator, index_collection> build_processor;
+        typedef threaded_processor<build_merge_func, typename VERTDB_BUCKET<merge_pair>::iterator, index_collection> build_merge_processor;
+        typedef threaded_processor<build_fill_func, typename index_collection::iterator, index_collection> build_fill_processor;
+
+        // Open addressing lookup into the frozen cell table
+        const frozen_cell* find_frozen( const key_type &index ) const
+        {
+            if( m_frozen_cells.empty() )
+                return nullptr;
+
+            size_t mask = m_frozen_cells.size() - 1;
+            size_t slot = std::hash<key_type>()( index ) & mask;
+            while( true )
+            {
+                const frozen_cell &cell = m_frozen_cells[slot];
+                if( cell.m_end == cell.m_begin )
+                    return nullptr;
+
+                if( cell.m_key == index )
+                    return &cell;
+
+                slot = ( slot + 1 ) & mask;
+            }
+        }
+
         struct bucket_processor_func
         {
             void operator()( const key_type &key, results_type &collector ) const
             {
-                auto values = m_cloud.find_bucket( m_location, m_radius, key );
-                collector.insert( collector.end(), values.begin(), values.end() );
+                m_cloud.find_bucket( m_location, m_radius, key, collector );
             }
 
             const self_type &m_cloud;
@@ -173,6 +1308,26 @@ namespace vd
         typedef threaded_processor<bucket_processor_func, typename key_collection::iterator, results_type> bucket_processor;
 
         scalar m_bucket_scale;
+        size_t m_parallel_threshold;
+
+        // Bounds of every key ever inserted, used to stop ring searches
+        key_type m_key_low;
+        key_type m_key_high;
+
+        size_t m_count;
         bucket_map m_data;
+
+        // Slot of each item within its bucket, so erase and move skip the bucket scan
+        slot_map m_slots;
+        bool m_slots_valid;
+
+        // Read-mostly layout built by freeze(); m_data is empty while frozen
+        bool m_frozen;
+        size_t m_frozen_cell_count;
+        frozen_table m_frozen_cells;
+        coordinate_collection m_frozen_x;
+        coordinate_collection m_frozen_y;
+        coordinate_collection m_frozen_z;
+        results_type m_frozen_items;
     };
 };
@@ -65,6 +65,12 @@
 #define VERTDB_DATA_STORAGE std::vector
 #endif
 
+// Container for per-vertex channel storage in vert_db, keyed by internal keys
+//  Defaults to dense columnar arrays; define as VERTDB_MAP for sparse hashed storage
+#ifndef VERTDB_CHANNEL
+#define VERTDB_CHANNEL vd::dense_channel
+#endif
+
 // Container for storage of a small number of items
 //  Often linearly searched
 #ifndef VERTDB_BUCKET
@@ -79,12 +85,74 @@
 #define VERTDB_BUCKET_SORTER std::sort
 #endif
 
+// Merges two adjacent sorted runs of a VERTDB_BUCKET in place
+#ifndef VERTDB_BUCKET_MERGER
+#include <algorithm>
+#define VERTDB_BUCKET_MERGER std::inplace_merge
+#endif
+
+// Finds the smallest element of a VERTDB_BUCKET range
+#ifndef VERTDB_MIN_ELEMENT
+#include <algorithm>
+#define VERTDB_MIN_ELEMENT std::min_element
+#endif
+
+// Exchanges two values, such as entries of a VERTDB_BUCKET
+#ifndef VERTDB_SWAP
+#include <utility>
+#define VERTDB_SWAP std::swap
+#endif
+
+// Copies a range into the storage an output iterator points at
+#ifndef VERTDB_COPY
+#include <algorithm>
+#define VERTDB_COPY std::copy
+#endif
+
+// Partially sorts a range so the element at a given position is the one a full sort would put there
+#ifndef VERTDB_NTH_ELEMENT
+#include <algorithm>
+#define VERTDB_NTH_ELEMENT std::nth_element
+#endif
+
+// Binary heap operations over a VERTDB_BUCKET, used for nearest-k candidates and shortest paths
+#ifndef VERTDB_HEAP_MAKE
+#include <algorithm>
+#define VERTDB_HEAP_MAKE std::make_heap
+#endif
+
+#ifndef VERTDB_HEAP_PUSH
+#include <algorithm>
+#define VERTDB_HEAP_PUSH std::push_heap
+#endif
+
+#ifndef VERTDB_HEAP_POP
+#include <algorithm>
+#define VERTDB_HEAP_POP std::pop_heap
+#endif
+
+#ifndef VERTDB_HEAP_SORTER
+#include <algorithm>
+#define VERTDB_HEAP_SORTER std::sort_heap
+#endif
+
 // Default type used to uniquely identify bones for skin weight operations
 #ifndef VERTDB_BONEID
 #include <string>
 #define VERTDB_BONEID std::string
 #endif
 
+// Small integer a vert_db interns each VERTDB_BONEID into for weight storage
+#ifndef VERTDB_BONEINDEX
+#include <cstdint>
+#define VERTDB_BONEINDEX std::uint16_t
+#endif
+
+// Default influence cap for vert_db weight storage (0 stores every influence in a VERTDB_BUCKET)
+#ifndef VERTDB_MAX_INFLUENCES
+#define VERTDB_MAX_INFLUENCES 0
+#endif
+
 // Default type used for storing bone weights
 #ifndef VERTDB_BONEWEIGHT
 #define VERTDB_BONEWEIGHT VERTDB_SCALAR
@@ -133,6 +201,22 @@
 #define VERTDB_IOTA std::iota
 #endif
 
+// Binary streams transfer_mapping serializes through
+#ifndef VERTDB_OSTREAM
+#include <ostream>
+#define VERTDB_OSTREAM std::ostream
+#endif
+
+#ifndef VERTDB_ISTREAM
+#include <istream>
+#define VERTDB_ISTREAM std::istream
+#endif
+
+// Largest number of values transfer_mapping::read allocates ahead of the data backing them
+#ifndef VERTDB_MAPPING_READ_CHUNK
+#define VERTDB_MAPPING_READ_CHUNK 65536
+#endif
+
 // Type that can wrap a reference through type deduction to get to VERTDB_TREAD invoke
 #ifndef VERTDB_REF
 #include <memory>
@@ -155,3 +239,104 @@
 #ifndef VERTDB_LOCKGUARD
 #define VERTDB_LOCKGUARD std::lock_guard
 #endif
+
+// Type that can RAII wrap a VERTDB_MUTEX and be handed to VERTDB_CONDITION to wait
+#ifndef VERTDB_UNIQUE_LOCK
+#include <mutex>
+#define VERTDB_UNIQUE_LOCK std::unique_lock
+#endif
+
+// Type that can block threads holding a VERTDB_UNIQUE_LOCK until notified
+#ifndef VERTDB_CONDITION
+#include <condition_variable>
+#define VERTDB_CONDITION std::condition_variable
+#endif
+
+// Template for values shared between threads without a lock
+#ifndef VERTDB_ATOMIC
+#include <atomic>
+#define VERTDB_ATOMIC std::atomic
+#endif
+
+// Memory order for VERTDB_ATOMIC values that only need atomicity, not ordering
+#ifndef VERTDB_MEMORY_RELAXED
+#include <atomic>
+#define VERTDB_MEMORY_RELAXED std::memory_order_relaxed
+#endif
+
+// Type-erased callable used for queued thread pool work
+#ifndef VERTDB_FUNCTION
+#include <functional>
+#define VERTDB_FUNCTION std::function
+#endif
+
+// Double ended container for per-worker task queues
+#ifndef VERTDB_DEQUE
+#include <deque>
+#define VERTDB_DEQUE std::deque
+#endif
+
+// Worker threads in the shared thread pool (0 uses hardware concurrency)
+#ifndef VERTDB_THREAD_POOL_SIZE
+#define VERTDB_THREAD_POOL_SIZE 0
+#endif
+
+// Number of work chunks queued per available thread by threaded_processor
+//  More chunks give idle workers something to steal when work is uneven
+#ifndef VERTDB_THREAD_CHUNKS
+#define VERTDB_THREAD_CHUNKS 4
+#endif
+
+// Grid cells a point_cloud radius query must touch before buckets are scanned in parallel
+//  Smaller queries scan inline on the calling thread
+#ifndef VERTDB_CLOUD_PARALLEL_CELLS
+#define VERTDB_CLOUD_PARALLEL_CELLS 1024
+#endif
+
+// Smallest breadth first search level that vert_db::find_connects_parallel expands across threads
+#ifndef VERTDB_CONNECTS_PARALLEL_LEVEL
+#define VERTDB_CONNECTS_PARALLEL_LEVEL 1024
+#endif
+
+// Points handed to each task when point_cloud::build keys and sorts in parallel
+#ifndef VERTDB_CLOUD_BUILD_CHUNK
+#define VERTDB_CLOUD_BUILD_CHUNK 4096
+#endif
+
+// vert_db::update_batch and batch inserts drop a built cloud and rebuild it on demand once a batch
+//  moves or adds more than 1/VERTDB_BATCH_REINDEX_DIVISOR of its points
+#ifndef VERTDB_BATCH_REINDEX_DIVISOR
+#define VERTDB_BATCH_REINDEX_DIVISOR 4
+#endif
+
+// Key-range lock shards vert_db::update_atomic picks from, so writers to different ranges run concurrently
+#ifndef VERTDB_WRITE_SHARDS
+#define VERTDB_WRITE_SHARDS 32
+#endif
+
+// Consecutive keys guarded by each write shard
+//  Must be a multiple of the dense_channel mask word size (64 bits) so shards never share a presence mask word
+#ifndef VERTDB_WRITE_SHARD_SPAN
+#define VERTDB_WRITE_SHARD_SPAN 64
+#endif
+
+// Queries handed to each task when a point_cloud batch query runs in parallel
+#ifndef VERTDB_CLOUD_BATCH_CHUNK
+#define VERTDB_CLOUD_BATCH_CHUNK 256
+#endif
+
+// Most points stored in a single kd_tree leaf
+#ifndef VERTDB_KDTREE_LEAF_SIZE
+#define VERTDB_KDTREE_LEAF_SIZE 16
+#endif
+
+// Points per occupied bucket that point_cloud::auto_rebucket aims for
+#ifndef VERTDB_CLOUD_TARGET_OCCUPANCY
+#define VERTDB_CLOUD_TARGET_OCCUPANCY 8
+#endif
+
+// Vertex count at which vert_db first re-tunes its clouds when auto rebucketing is on
+//  The next re-tune happens each time the count doubles
+#ifndef VERTDB_AUTO_REBUCKET_MIN
+#define VERTDB_AUTO_REBUCKET_MIN 1024
+#endif
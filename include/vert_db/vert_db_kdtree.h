@@ -0,0 +1,612 @@
+#pragma once
+
+#include "vert_db_config.h"
+#include "vert_db_types.h"
+#include "vert_db_utils.h"
+#include "vert_db_cloud.h"
+
+namespace vd
+{
+    // Static KD-tree with the same query interface as point_cloud.
+    //  Inserts are buffered and the tree is rebuilt in bulk by the next query, so it suits
+    //  data that is loaded once and queried many times, especially with uneven density
+    //  where a single grid bucket width fits nothing well.
+    //  K is unused and only present so kd_tree can stand in for point_cloud as a template argument.
+    template<typename T, typename V = vec3, typename K = vec3i, typename S = real>
+    class kd_tree
+    {
+    public:
+        typedef kd_tree<T, V, K, S> self_type;
+        typedef T mapped_type;
+        typedef V point_type;
+        typedef K key_type;
+        typedef S scalar;
+
+        typedef VERTDB_BUCKET<mapped_type> results_type;
+        typedef VERTDB_BUCKET<point_type> point_collection;
+        typedef batch_results<mapped_type> batch_type;
+        typedef VERTDB_BUCKET<unsigned long long> sort_key_collection;
+        typedef VERTDB_MAP<mapped_type, size_t> slot_map;
+
+        typedef VERTDB_NUMERIC_LIMITS<scalar> limits_type;
+
+        static inline constexpr scalar epsilon()
+        {
+            return limits_type::epsilon() * VERTDB_EPSILON_SCALE;
+        }
+
+        static inline constexpr scalar unlimited()
+        {
+            return limits_type::max();
+        }
+
+        kd_tree( size_t leaf_size = VERTDB_KDTREE_LEAF_SIZE )
+            : m_leaf_size( ( leaf_size > 0 ) ? leaf_size : 1 )
+            , m_points()
+            , m_items()
+            , m_nodes()
+            , m_leaves()
+            , m_slots()
+            , m_slots_valid( false )
+            , m_built( true )
+            , m_build_mutex()
+        {
+        }
+
+        virtual ~kd_tree()
+        {
+        }
+
+        // Number of stored points
+        size_t size() const
+        {
+            return m_points.size();
+        }
+
+        size_t count() const
+        {
+            return m_points.size();
+        }
+
+        // Leaves stand in for buckets
+        cloud_stats stats() const
+        {
+            build();
+
+            cloud_stats result;
+            result.point_count = m_points.size();
+
+            result.min_points = m_points.empty() ? 0 : VERTDB_NUMERIC_LIMITS<size_t>::max();
+            for( const auto &node : m_nodes )
+            {
+                if( node.m_axis >= 0 )
+                    continue;
+
+                size_t points = node.m_end - node.m_begin;
+                result.min_points = ( points < result.min_points ) ? points : result.min_points;
+                result.max_points = ( points > result.max_points ) ? points : result.max_points;
+
+                size_t bin = 0;
+                while( ( points >> ( bin + 1 ) ) > 0 )
+                    ++bin;
+
+                if( bin >= result.histogram.size() )
+                    result.histogram.resize( bin + 1, 0 );
+
+                ++result.histogram[bin];
+                ++result.bucket_count;
+            }
+
+            if( result.bucket_count > 0 )
+                result.mean_points = static_cast<real>( result.point_count ) / result.bucket_count;
+
+            return result;
+        }
+
+        // Trees are always in their packed layout once built
+        void freeze()
+        {
+            build();
+        }
+
+        // Trees adapt to density on build, so there is nothing to tune
+        void auto_rebucket( size_t = VERTDB_CLOUD_TARGET_OCCUPANCY )
+        {
+        }
+
+        void insert( const point_type &location, const mapped_type &item )
+        {
+            if( m_slots_valid )
+                m_slots[item] = m_items.size();
+
+            m_points.emplace_back( location );
+            m_items.emplace_back( item );
+            m_built = false;
+        }
+
+        void clear()
+        {
+            m_points.clear();
+            m_items.clear();
+            m_nodes.clear();
+            m_leaves.clear();
+            clear_slots();
+            m_built = true;
+        }
+
+        // The slot index finds item in O(1) on average.  Removal reorders storage, so the tree
+        //  rebuilds on the next query.
+        bool erase( const point_type &, const mapped_type &item )
+        {
+            size_t index = find_slot( item );
+            if( index == m_items.size() )
+                return false;
+
+            size_t last = m_items.size() - 1;
+            if( index != last )
+            {
+                m_points[index] = m_points[last];
+                m_items[index] = m_items[last];
+                m_slots[m_items[index]] = index;
+            }
+
+            m_points.pop_back();
+            m_items.pop_back();
+            m_slots.erase( item );
+            m_built = false;
+            return true;
+        }
+
+        // A point that stays inside its leaf's bounds leaves every box in the tree valid,
+        //  so the tree stays built; moving anywhere else rebuilds it on the next query.
+        void move( const point_type &, const point_type &new_location, const mapped_type &item )
+        {
+            size_t index = find_slot( item );
+            if( index == m_items.size() )
+            {
+                insert( new_location, item );
+                return;
+            }
+
+            m_points[index] = new_location;
+            if( !m_built || !leaf_contains( index, new_location ) )
+                m_built = false;
+        }
+
+        // Replace the contents with items[i] at points[i]; the tree builds on the next query
+        void build( const point_collection &points, const results_type &items )
+        {
+            size_t count = ( points.size() < items.size() ) ? points.size() : items.size();
+            m_points.assign( points.begin(), points.begin() + count );
+            m_items.assign( items.begin(), items.begin() + count );
+            m_nodes.clear();
+            clear_slots();
+            m_built = false;
+        }
+
+        // Build now instead of on the next query
+        void build() const
+        {
+            if( m_built )
+                return;
+
+            lock_type lock( m_build_mutex );
+            if( m_built )
+                return;
+
+            m_nodes.clear();
+
+            size_t count = m_points.size();
+            if( count > 0 )
+            {
+                index_collection order( count );
+                VERTDB_IOTA( order.begin(), order.end(), 0 );
+                build_node( order, 0, count );
+
+                // Store points in leaf order so each leaf is one contiguous run
+                point_collection points;
+                results_type items;
+                points.reserve( count );
+                items.reserve( count );
+                for( size_t index : order )
+                {
+                    points.emplace_back( m_points[index] );
+                    items.emplace_back( m_items[index] );
+                }
+
+                m_points = VERTDB_MOVE( points );
+                m_items = VERTDB_MOVE( items );
+            }
+
+            // Storage moved into leaf order, so record each slot's leaf and drop the slot index
+            m_leaves.assign( count, 0 );
+            for( size_t node = 0; node < m_nodes.size(); ++node )
+            {
+                if( m_nodes[node].m_axis >= 0 )
+                    continue;
+
+                for( size_t i = m_nodes[node].m_begin; i < m_nodes[node].m_end; ++i )
+                {
+                    m_leaves[i] = node;
+                }
+            }
+
+            clear_slots();
+
+            m_built = true;
+        }
+
+        results_type find( const point_type &location, scalar radius=epsilon() ) const
+        {
+            results_type results;
+            find( location, radius, results );
+            return results;
+        }
+
+        void find( const point_type &location, scalar radius, results_type &results ) const
+        {
+            results.clear();
+            visit( location, radius, [&]( const mapped_type &item, scalar )
+            {
+                results.emplace_back( item );
+            } );
+        }
+
+        // Calls visitor( item, distance_squared ) for every match, on the calling thread
+        template<typename F>
+        void visit( const point_type &location, scalar radius, F visitor ) const
+        {
+            build();
+            if( m_nodes.empty() )
+                return;
+
+            visit_node( 0, location, radius * radius, visitor );
+        }
+
+        batch_type find_batch( const point_collection &locations, scalar radius ) const
+        {
+            build();
+
+            // Quantize onto a coarse grid over the root bounds for a locality order
+            scalar scale = 1;
+            if( !m_nodes.empty() )
+            {
+                const node_type &root = m_nodes[0];
+                scalar extent = axis_value( root.m_high, 0 ) - axis_value( root.m_low, 0 );
+                for( int axis = 1; axis < 3; ++axis )
+                {
+                    scalar axis_extent = axis_value( root.m_high, axis ) - axis_value( root.m_low, axis );
+                    extent = ( axis_extent > extent ) ? axis_extent : extent;
+                }
+
+                if( extent > 0 )
+                    scale = 1024 / extent;
+            }
+
+            sort_key_collection sort_keys;
+            sort_keys.reserve( locations.size() );
+            for( const auto &location : locations )
+            {
+                sort_keys.emplace_back( morton_code( floor_vec3i( location * scale ) ) );
+            }
+
+            return batch_query<self_type>::run( *this, locations, radius, sort_keys );
+        }
+
+        bool find_nearest( const point_type &location, mapped_type &result, scalar max_radius=unlimited() ) const
+        {
+            return find_nearest( location, result, max_radius, accept_all() );
+        }
+
+        template<typename P>
+        bool find_nearest( const point_type &location, mapped_type &result, scalar max_radius, P predicate ) const
+        {
+            results_type found = find_k_nearest( location, 1, max_radius, predicate );
+            if( found.empty() )
+                return false;
+
+            result = found.front();
+            return true;
+        }
+
+        results_type find_k_nearest( const point_type &location, size_t count, scalar max_radius=unlimited() ) const
+        {
+            return find_k_nearest( location, count, max_radius, accept_all() );
+        }
+
+        template<typename P>
+        results_type find_k_nearest( const point_type &location, size_t count, scalar max_radius, P predicate ) const
+        {
+            results_type results;
+
+            build();
+            if( ( count == 0 ) || m_nodes.empty() )
+                return results;
+
+            candidate_collection best;
+            best.reserve( count + 1 );
+
+            scalar limit_sq = ( max_radius < unlimited() ) ? max_radius * max_radius : unlimited();
+            nearest_node( 0, location, count, limit_sq, predicate, best );
+
+            VERTDB_HEAP_SORTER( best.begin(), best.end(), candidate_less() );
+
+            results.reserve( best.size() );
+            for( const auto &candidate : best )
+            {
+                results.emplace_back( candidate.second );
+            }
+
+            return results;
+        }
+
+    protected:
+        typedef VERTDB_BUCKET<size_t> index_collection;
+        typedef VERTDB_PAIR<scalar, mapped_type> candidate_type;
+        typedef VERTDB_BUCKET<candidate_type> candidate_collection;
+
+        static const size_t c_leaf = static_cast<size_t>( -1 );
+
+        size_t find_item( const mapped_type &item ) const
+        {
+            size_t index = 0;
+            for( ; index < m_items.size(); ++index )
+            {
+                if( m_items[index] == item )
+                    break;
+            }
+
+            return index;
+        }
+
+        // Storage index of item from the slot index, building the index first if needed.
+        //  An item stored more than once only indexes its latest slot, so a miss falls back to a scan.
+        size_t find_slot( const mapped_type &item )
+        {
+            if( !m_slots_valid )
+            {
+                m_slots.clear();
+                m_slots.reserve( m_items.size() );
+                for( size_t i = 0; i < m_items.size(); ++i )
+                {
+                    m_slots[m_items[i]] = i;
+                }
+
+                m_slots_valid = true;
+            }
+
+            auto found = m_slots.find( item );
+            if( ( found != m_slots.end() ) && ( found->second < m_items.size() ) && ( m_items[found->second] == item ) )
+                return found->second;
+
+            return find_item( item );
+        }
+
+        // Reordering storage drops the slot index rather than keeping it current
+        void clear_slots() const
+        {
+            slot_map empty;
+            m_slots.swap( empty );
+            m_slots_valid = false;
+        }
+
+        bool leaf_contains( size_t index, const point_type &location ) const
+        {
+            if( index >= m_leaves.size() )
+                return false;
+
+            const node_type &leaf = m_nodes[m_leaves[index]];
+            return ( location.x >= leaf.m_low.x ) && ( location.x <= leaf.m_high.x )
+                && ( location.y >= leaf.m_low.y ) && ( location.y <= leaf.m_high.y )
+                && ( location.z >= leaf.m_low.z ) && ( location.z <= leaf.m_high.z );
+        }
+
+        struct node_type
+        {
+            // Points [m_begin, m_end) in storage order
+            size_t m_begin;
+            size_t m_end;
+
+            // Children, or c_leaf
+            size_t m_left;
+            size_t m_right;
+
+            int m_axis;
+            scalar m_split;
+
+            point_type m_low;
+            point_type m_high;
+        };
+
+        typedef VERTDB_BUCKET<node_type> node_collection;
+
+        struct candidate_less
+        {
+            bool operator()( const candidate_type &a, const candidate_type &b ) const
+            {
+                return a.first < b.first;
+            }
+        };
+
+        struct accept_all
+        {
+            bool operator()( const mapped_type & ) const
+            {
+                return true;
+            }
+        };
+
+        static inline scalar axis_value( const point_type &point, int axis )
+        {
+            return ( axis == 0 ) ? point.x : ( ( axis == 1 ) ? point.y : point.z );
+        }
+
+        // Squared distance from location to the node's bounding box
+        static inline scalar box_distance_sq( const node_type &node, const point_type &location )
+        {
+            scalar dist_sq = 0;
+            for( int axis = 0; axis < 3; ++axis )
+            {
+                scalar value = axis_value( location, axis );
+                scalar low = axis_value( node.m_low, axis );
+                scalar high = axis_value( node.m_high, axis );
+
+                scalar outside = ( value < low ) ? low - value : ( ( value > high ) ? value - high : 0 );
+                dist_sq += outside * outside;
+            }
+
+            return dist_sq;
+        }
+
+        size_t build_node( index_collection &order, size_t begin, size_t end ) const
+        {
+            node_type node{};
+            node.m_begin = begin;
+            node.m_end = end;
+            node.m_left = c_leaf;
+            node.m_right = c_leaf;
+            node.m_axis = -1;
+
+            node.m_low = m_points[order[begin]];
+            node.m_high = node.m_low;
+            for( size_t i = begin + 1; i < end; ++i )
+            {
+                const point_type &point = m_points[order[i]];
+                node.m_low = point_type{ ( point.x < node.m_low.x ) ? point.x : node.m_low.x,
+                                         ( point.y < node.m_low.y ) ? point.y : node.m_low.y,
+                                         ( point.z < node.m_low.z ) ? point.z : node.m_low.z };
+                node.m_high = point_type{ ( point.x > node.m_high.x ) ? point.x : node.m_high.x,
+                                          ( point.y > node.m_high.y ) ? point.y : node.m_high.y,
+                                          ( point.z > node.m_high.z ) ? point.z : node.m_high.z };
+            }
+
+            size_t index = m_nodes.size();
+            m_nodes.emplace_back( node );
+
+            if( ( end - begin ) <= m_leaf_size )
+                return index;
+
+            // Split the widest axis at the median
+            int axis = 0;
+            scalar widest = -1;
+            for( int check = 0; check < 3; ++check )
+            {
+                scalar width = axis_value( node.m_high, check ) - axis_value( node.m_low, check );
+                if( width > widest )
+                {
+                    widest = width;
+                    axis = check;
+                }
+            }
+
+            size_t middle = begin + ( end - begin ) / 2;
+            VERTDB_NTH_ELEMENT( order.begin() + begin, order.begin() + middle, order.begin() + end, [&]( size_t a, size_t b )
+            {
+                return axis_value( m_points[a], axis ) < axis_value( m_points[b], axis );
+            } );
+
+            size_t left = build_node( order, begin, middle );
+            size_t right = build_node( order, middle, end );
+
+            node_type &built = m_nodes[index];
+            built.m_axis = axis;
+            built.m_split = axis_value( m_points[order[middle]], axis );
+            built.m_left = left;
+            built.m_right = right;
+
+            return index;
+        }
+
+        template<typename F>
+        void visit_node( size_t index, const point_type &location, scalar rad_sq, F &visitor ) const
+        {
+            const node_type &node = m_nodes[index];
+            if( box_distance_sq( node, location ) > rad_sq )
+                return;
+
+            if( node.m_axis < 0 )
+            {
+                for( size_t i = node.m_begin; i < node.m_end; ++i )
+                {
+                    V between = location - m_points[i];
+                    scalar dist_sq = dot( between, between );
+                    if( dist_sq <= rad_sq )
+                    {
+                        visitor( m_items[i], dist_sq );
+                    }
+                }
+
+                return;
+            }
+
+            visit_node( node.m_left, location, rad_sq, visitor );
+            visit_node( node.m_right, location, rad_sq, visitor );
+        }
+
+        template<typename P>
+        void nearest_node( size_t index, const point_type &location, size_t count, scalar limit_sq, P &predicate, candidate_collection &best ) const
+        {
+            const node_type &node = m_nodes[index];
+
+            scalar box_sq = box_distance_sq( node, location );
+            if( box_sq > limit_sq )
+                return;
+
+            if( ( best.size() == count ) && ( box_sq >= best.front().first ) )
+                return;
+
+            if( node.m_axis < 0 )
+            {
+                for( size_t i = node.m_begin; i < node.m_end; ++i )
+                {
+                    V between = location - m_points[i];
+                    scalar dist_sq = dot( between, between );
+                    if( dist_sq > limit_sq )
+                        continue;
+
+                    if( ( best.size() == count ) && ( dist_sq >= best.front().first ) )
+                        continue;
+
+                    if( !predicate( m_items[i] ) )
+                        continue;
+
+                    best.emplace_back( dist_sq, m_items[i] );
+                    VERTDB_HEAP_PUSH( best.begin(), best.end(), candidate_less() );
+
+                    if( best.size() > count )
+                    {
+                        VERTDB_HEAP_POP( best.begin(), best.end(), candidate_less() );
+                        best.pop_back();
+                    }
+                }
+
+                return;
+            }
+
+            // Near side first so the far side is more likely to be pruned
+            bool left_first = axis_value( location, node.m_axis ) < node.m_split;
+            size_t near_child = left_first ? node.m_left : node.m_right;
+            size_t far_child = left_first ? node.m_right : node.m_left;
+
+            nearest_node( near_child, location, count, limit_sq, predicate, best );
+            nearest_node( far_child, location, count, limit_sq, predicate, best );
+        }
+
+        size_t m_leaf_size;
+
+        // Storage is reordered into leaf order by build()
+        mutable point_collection m_points;
+        mutable results_type m_items;
+        mutable node_collection m_nodes;
+
+        // Leaf node holding each storage slot, valid while the tree is built
+        mutable index_collection m_leaves;
+
+        // Storage index of each item, so erase and move skip the item scan
+        mutable slot_map m_slots;
+        mutable bool m_slots_valid;
+
+        mutable VERTDB_ATOMIC<bool> m_built;
+        mutable mutex_type m_build_mutex;
+    };
+};
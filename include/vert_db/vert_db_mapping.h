@@ -0,0 +1,420 @@
+#pragma once
+
+#include "vert_db_config.h"
+#include "vert_db_types.h"
+#include "vert_db_item.h"
+#include "vert_db_thread.h"
+
+namespace vd
+{
+    // How a resolver turns its source keys into a def for one destination key
+    template<typename S>
+    struct transfer_rule
+    {
+        bool operator==( const transfer_rule &other ) const
+        {
+            return ( m_flags == other.m_flags )
+                && ( m_blend == other.m_blend )
+                && ( m_weight_total == other.m_weight_total )
+                && ( m_weight_clip == other.m_weight_clip )
+                && ( m_weight_normalize == other.m_weight_normalize );
+        }
+
+        // Channels to set
+        item_flags m_flags;
+
+        // Copy every channel from the first source, or combine them all with vert_db::blend_channels
+        bool m_blend;
+
+        // Weight options handed to vert_db::blend_channels
+        size_t m_weight_total;
+        S m_weight_clip;
+        bool m_weight_normalize;
+    };
+
+    // Recorded correspondence of a transfer: for each destination key, the source keys it drew from,
+    //  their kernel weights and the rule they were blended with.  Rows are stored compressed like
+    //  compiled_adjacency.  Re-applying a mapping is a gather-and-blend of the source's current
+    //  channels without any spatial queries, so it stays valid while source topology and positions do.
+    template<typename K, typename S=real>
+    class transfer_mapping
+    {
+    public:
+        typedef transfer_mapping<K, S> self_type;
+        typedef K key_type;
+        typedef S scalar;
+        typedef transfer_rule<S> rule_type;
+        typedef VERTDB_BUCKET<key_type> key_collection;
+        typedef VERTDB_BUCKET<scalar> scalar_collection;
+        typedef VERTDB_BUCKET<size_t> index_collection;
+        typedef VERTDB_BUCKET<rule_type> rule_collection;
+
+        // Bumped whenever the serialized layout changes
+        static inline constexpr unsigned int version()
+        {
+            return 2;
+        }
+
+        // One destination key's sources and weights, pointing into the mapping
+        struct row
+        {
+            key_type m_key;
+            const rule_type *m_rule;
+            const key_type *m_sources;
+            const scalar *m_weights;
+            size_t m_count;
+        };
+
+        transfer_mapping()
+            : m_rules()
+            , m_keys()
+            , m_row_rules()
+            , m_offsets( 1, 0 )
+            , m_sources()
+            , m_weights()
+        {
+        }
+
+        size_t size() const
+        {
+            return m_keys.size();
+        }
+
+        bool empty() const
+        {
+            return m_keys.empty();
+        }
+
+        // Destination keys, in the order their rows were added
+        const key_collection& keys() const
+        {
+            return m_keys;
+        }
+
+        const rule_collection& rules() const
+        {
+            return m_rules;
+        }
+
+        row operator[]( size_t index ) const
+        {
+            size_t begin = m_offsets[index];
+            return row{ m_keys[index], &m_rules[m_row_rules[index]], m_sources.data() + begin, m_weights.data() + begin, m_offsets[index + 1] - begin };
+        }
+
+        // Index of rule, adding it if no row uses it yet
+        size_t add_rule( const rule_type &rule )
+        {
+            for( size_t i = 0; i < m_rules.size(); ++i )
+            {
+                if( m_rules[i] == rule )
+                    return i;
+            }
+
+            m_rules.emplace_back( rule );
+            return m_rules.size() - 1;
+        }
+
+        // Record that key draws from sources by weights under rule.
+        //  Returns false without adding anything if sources is empty, weights does not match it in size
+        //  or rule was not added, the same rows read() rejects.
+        bool add_row( const key_type &key, size_t rule, const key_collection &sources, const scalar_collection &weights )
+        {
+            if( sources.empty() || ( sources.size() != weights.size() ) || ( rule >= m_rules.size() ) )
+                return false;
+
+            m_keys.emplace_back( key );
+            m_row_rules.emplace_back( rule );
+            m_sources.insert( m_sources.end(), sources.begin(), sources.end() );
+            m_weights.insert( m_weights.end(), weights.begin(), weights.end() );
+            m_offsets.emplace_back( m_sources.size() );
+            return true;
+        }
+
+        void clear()
+        {
+            m_rules.clear();
+            m_keys.clear();
+            m_row_rules.clear();
+            m_offsets.assign( 1, 0 );
+            m_sources.clear();
+            m_weights.clear();
+        }
+
+        // Fill to_set for one row from source's current channels
+        template<typename D>
+        static void blend( const D &source, const row &entry, typename D::def_type &to_set )
+        {
+            const rule_type &rule = *entry.m_rule;
+            key_type primary = entry.m_sources[0];
+            if( !rule.m_blend )
+            {
+                to_set.flags |= rule.m_flags;
+                source.gather( primary, to_set );
+                return;
+            }
+
+            source.blend_channels( entry.m_sources, entry.m_weights, entry.m_count, rule.m_flags, to_set, rule.m_weight_total, rule.m_weight_clip, rule.m_weight_normalize );
+        }
+
+        // Blend every row from source and commit them to results in one update_batch
+        template<typename D>
+        void apply( const D &source, D &results ) const
+        {
+            apply( source, results, 0, size() );
+        }
+
+        // apply() for rows [first, last).  Rows are blended in parallel.
+        template<typename D>
+        void apply( const D &source, D &results, size_t first, size_t last ) const
+        {
+            if( first >= last )
+                return;
+
+            index_collection rows( last - first );
+            VERTDB_IOTA( rows.begin(), rows.end(), first );
+
+            typename D::staged_collection staged;
+            staged.reserve( rows.size() );
+
+            apply_func<D> func{ *this, source };
+            threaded_processor<apply_func<D>, typename index_collection::iterator, typename D::staged_collection> processor( func, rows.begin(), rows.end(), staged );
+            processor.join();
+
+            results.update_batch( staged.begin(), staged.end() );
+        }
+
+        bool operator==( const self_type &other ) const
+        {
+            return ( m_rules == other.m_rules )
+                && ( m_keys == other.m_keys )
+                && ( m_row_rules == other.m_row_rules )
+                && ( m_offsets == other.m_offsets )
+                && ( m_sources == other.m_sources )
+                && ( m_weights == other.m_weights );
+        }
+
+        bool operator!=( const self_type &other ) const
+        {
+            return !( *this == other );
+        }
+
+        // Binary serialization.  The header records key and scalar sizes, so read() rejects
+        //  data written by a build with different types instead of misreading it.  Counts and indices
+        //  are always unsigned long long, whatever size_t is.
+        bool write( VERTDB_OSTREAM &stream ) const
+        {
+            stream.write( "VDTM", 4 );
+            write_value( stream, version() );
+            write_value( stream, static_cast<unsigned int>( sizeof( key_type ) ) );
+            write_value( stream, static_cast<unsigned int>( sizeof( scalar ) ) );
+
+            write_value( stream, static_cast<unsigned long long>( m_rules.size() ) );
+            for( const auto &rule : m_rules )
+            {
+                write_value( stream, static_cast<item_flags_backing>( rule.m_flags ) );
+                write_value( stream, static_cast<unsigned char>( rule.m_blend ) );
+                write_value( stream, static_cast<unsigned long long>( rule.m_weight_total ) );
+                write_value( stream, rule.m_weight_clip );
+                write_value( stream, static_cast<unsigned char>( rule.m_weight_normalize ) );
+            }
+
+            write_array( stream, m_keys );
+            write_indices( stream, m_row_rules );
+            write_indices( stream, m_offsets );
+            write_array( stream, m_sources );
+            write_array( stream, m_weights );
+
+            return !stream.fail();
+        }
+
+        bool read( VERTDB_ISTREAM &stream )
+        {
+            clear();
+
+            char magic[4] = {};
+            stream.read( magic, 4 );
+            if( stream.fail() || ( magic[0] != 'V' ) || ( magic[1] != 'D' ) || ( magic[2] != 'T' ) || ( magic[3] != 'M' ) )
+                return false;
+
+            unsigned int stored_version = 0;
+            unsigned int key_size = 0;
+            unsigned int scalar_size = 0;
+            read_value( stream, stored_version );
+            read_value( stream, key_size );
+            read_value( stream, scalar_size );
+            if( ( stored_version != version() ) || ( key_size != sizeof( key_type ) ) || ( scalar_size != sizeof( scalar ) ) )
+                return false;
+
+            unsigned long long rule_count = 0;
+            read_value( stream, rule_count );
+            for( unsigned long long i = 0; ( i < rule_count ) && !stream.fail(); ++i )
+            {
+                item_flags_backing flags = 0;
+                unsigned char blend = 0;
+                unsigned long long weight_total = 0;
+                unsigned char weight_normalize = 0;
+
+                rule_type rule{};
+                read_value( stream, flags );
+                read_value( stream, blend );
+                read_value( stream, weight_total );
+                read_value( stream, rule.m_weight_clip );
+                read_value( stream, weight_normalize );
+
+                rule.m_flags = static_cast<item_flags>( flags );
+                rule.m_blend = blend != 0;
+                rule.m_weight_total = static_cast<size_t>( weight_total );
+                rule.m_weight_normalize = weight_normalize != 0;
+                m_rules.emplace_back( rule );
+            }
+
+            // Every count is checked before anything is allocated for it
+            unsigned long long key_limit = bytes_left( stream ) / sizeof( key_type );
+            bool valid = read_array( stream, m_keys, 0, key_limit )
+                && read_indices( stream, m_row_rules, m_keys.size(), m_keys.size() )
+                && read_indices( stream, m_offsets, m_keys.size() + 1, m_keys.size() + 1 )
+                && read_array( stream, m_sources, m_offsets.back(), m_offsets.back() )
+                && read_array( stream, m_weights, m_sources.size(), m_sources.size() )
+                && is_consistent();
+
+            if( !valid )
+                clear();
+
+            return valid;
+        }
+
+    protected:
+        template<typename D>
+        struct apply_func
+        {
+            void operator()( size_t index, typename D::staged_collection &collector )
+            {
+                row entry = m_mapping[index];
+                auto to_set = D::make_def();
+                blend( m_source, entry, to_set );
+                collector.emplace_back( entry.m_key, VERTDB_MOVE( to_set ) );
+            }
+
+            const self_type &m_mapping;
+            const D &m_source;
+        };
+
+        // Offsets and rule indices must stay inside the arrays they index
+        bool is_consistent() const
+        {
+            if( ( m_offsets.size() != m_keys.size() + 1 ) || ( m_row_rules.size() != m_keys.size() ) )
+                return false;
+
+            if( ( m_offsets.front() != 0 ) || ( m_offsets.back() != m_sources.size() ) || ( m_sources.size() != m_weights.size() ) )
+                return false;
+
+            for( size_t i = 0; i < m_keys.size(); ++i )
+            {
+                if( ( m_offsets[i] >= m_offsets[i + 1] ) || ( m_row_rules[i] >= m_rules.size() ) )
+                    return false;
+            }
+
+            return true;
+        }
+
+        template<typename V>
+        static void write_value( VERTDB_OSTREAM &stream, const V &value )
+        {
+            stream.write( reinterpret_cast<const char*>( &value ), sizeof( V ) );
+        }
+
+        template<typename V>
+        static void read_value( VERTDB_ISTREAM &stream, V &value )
+        {
+            stream.read( reinterpret_cast<char*>( &value ), sizeof( V ) );
+        }
+
+        template<typename C>
+        static void write_array( VERTDB_OSTREAM &stream, const C &values )
+        {
+            write_value( stream, static_cast<unsigned long long>( values.size() ) );
+            if( !values.empty() )
+                stream.write( reinterpret_cast<const char*>( values.data() ), values.size() * sizeof( values[0] ) );
+        }
+
+        // Read an array written by write_array, failing if its count is outside [low, high].
+        //  Values arrive VERTDB_MAPPING_READ_CHUNK at a time, so a count the stream cannot back
+        //  only allocates as far as the data actually goes.
+        template<typename C>
+        static bool read_array( VERTDB_ISTREAM &stream, C &values, unsigned long long low, unsigned long long high )
+        {
+            unsigned long long count = 0;
+            read_value( stream, count );
+            if( stream.fail() || ( count < low ) || ( count > high ) )
+                return false;
+
+            values.clear();
+            while( values.size() < count )
+            {
+                size_t first = values.size();
+                unsigned long long remaining = count - first;
+                size_t chunk = static_cast<size_t>( ( remaining < VERTDB_MAPPING_READ_CHUNK ) ? remaining : VERTDB_MAPPING_READ_CHUNK );
+                values.resize( first + chunk );
+
+                stream.read( reinterpret_cast<char*>( values.data() + first ), chunk * sizeof( values[0] ) );
+                if( stream.fail() )
+                    return false;
+            }
+
+            return true;
+        }
+
+        // Indices are stored as unsigned long long, so the layout does not depend on sizeof( size_t )
+        static void write_indices( VERTDB_OSTREAM &stream, const index_collection &values )
+        {
+            VERTDB_BUCKET<unsigned long long> stored( values.begin(), values.end() );
+            write_array( stream, stored );
+        }
+
+        // Read indices written by write_indices, failing if one does not fit in a size_t
+        static bool read_indices( VERTDB_ISTREAM &stream, index_collection &values, unsigned long long low, unsigned long long high )
+        {
+            VERTDB_BUCKET<unsigned long long> stored;
+            if( !read_array( stream, stored, low, high ) )
+                return false;
+
+            values.clear();
+            values.reserve( stored.size() );
+            for( auto index : stored )
+            {
+                if( index > VERTDB_NUMERIC_LIMITS<size_t>::max() )
+                    return false;
+
+                values.emplace_back( static_cast<size_t>( index ) );
+            }
+
+            return true;
+        }
+
+        // Bytes from the read position to the end of stream, or no limit if the stream cannot seek
+        static unsigned long long bytes_left( VERTDB_ISTREAM &stream )
+        {
+            unsigned long long unlimited = VERTDB_NUMERIC_LIMITS<unsigned long long>::max();
+            auto here = stream.tellg();
+            if( stream.fail() || ( here < 0 ) )
+                return unlimited;
+
+            stream.seekg( 0, VERTDB_ISTREAM::end );
+            auto end = stream.tellg();
+            stream.clear();
+            stream.seekg( here );
+            if( ( end < 0 ) || ( end < here ) )
+                return unlimited;
+
+            return static_cast<unsigned long long>( end - here );
+        }
+
+        rule_collection m_rules;
+        key_collection m_keys;
+        index_collection m_row_rules;
+        index_collection m_offsets;
+        key_collection m_sources;
+        scalar_collection m_weights;
+    };
+};
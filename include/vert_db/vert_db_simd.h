@@ -0,0 +1,200 @@
+#pragma once
+
+#include "vert_db_config.h"
+#include "vert_db_types.h"
+
+// Pick the widest instruction set the compiler is targeting
+//  Define VERTDB_NO_SIMD to force the scalar kernels
+#ifndef VERTDB_NO_SIMD
+    #if defined(__AVX__)
+        #include <immintrin.h>
+        #define VERTDB_SIMD_AVX 1
+    #elif defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && ( _M_IX86_FP >= 2 ) )
+        #include <emmintrin.h>
+        #define VERTDB_SIMD_SSE2 1
+    #endif
+#endif
+
+namespace vd
+{
+    // Finds points in structure-of-arrays storage within sqrt(rad_sq) of a query point.
+    //  Writes the index of each hit to hits and its squared distance to dist_sq, returning the hit count.
+    //  hits and dist_sq must have room for count entries.
+    template<typename S>
+    struct radius_kernel
+    {
+        static inline size_t filter( const S *xs, const S *ys, const S *zs, size_t count, S qx, S qy, S qz, S rad_sq, size_t *hits, S *dist_sq )
+        {
+            return filter_scalar( xs, ys, zs, 0, count, qx, qy, qz, rad_sq, hits, dist_sq, 0 );
+        }
+
+        static inline size_t filter_scalar( const S *xs, const S *ys, const S *zs, size_t begin, size_t end, S qx, S qy, S qz, S rad_sq, size_t *hits, S *dist_sq, size_t found )
+        {
+            for( size_t i = begin; i < end; ++i )
+            {
+                S dx = xs[i] - qx;
+                S dy = ys[i] - qy;
+                S dz = zs[i] - qz;
+                S dist = ( dx * dx ) + ( dy * dy ) + ( dz * dz );
+                if( dist <= rad_sq )
+                {
+                    hits[found] = i;
+                    dist_sq[found] = dist;
+                    ++found;
+                }
+            }
+
+            return found;
+        }
+    };
+
+#if defined(VERTDB_SIMD_AVX)
+    template<>
+    inline size_t radius_kernel<double>::filter( const double *xs, const double *ys, const double *zs, size_t count, double qx, double qy, double qz, double rad_sq, size_t *hits, double *dist_sq )
+    {
+        const __m256d vqx = _mm256_set1_pd( qx );
+        const __m256d vqy = _mm256_set1_pd( qy );
+        const __m256d vqz = _mm256_set1_pd( qz );
+        const __m256d vrad = _mm256_set1_pd( rad_sq );
+
+        size_t found = 0;
+        size_t i = 0;
+        for( ; i + 4 <= count; i += 4 )
+        {
+            __m256d dx = _mm256_sub_pd( _mm256_loadu_pd( xs + i ), vqx );
+            __m256d dy = _mm256_sub_pd( _mm256_loadu_pd( ys + i ), vqy );
+            __m256d dz = _mm256_sub_pd( _mm256_loadu_pd( zs + i ), vqz );
+            __m256d dist = _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( dx, dx ), _mm256_mul_pd( dy, dy ) ), _mm256_mul_pd( dz, dz ) );
+
+            int mask = _mm256_movemask_pd( _mm256_cmp_pd( dist, vrad, _CMP_LE_OQ ) );
+            if( mask == 0 )
+                continue;
+
+            double lanes[4];
+            _mm256_storeu_pd( lanes, dist );
+            for( int lane = 0; lane < 4; ++lane )
+            {
+                if( mask & ( 1 << lane ) )
+                {
+                    hits[found] = i + lane;
+                    dist_sq[found] = lanes[lane];
+                    ++found;
+                }
+            }
+        }
+
+        return filter_scalar( xs, ys, zs, i, count, qx, qy, qz, rad_sq, hits, dist_sq, found );
+    }
+
+    template<>
+    inline size_t radius_kernel<float>::filter( const float *xs, const float *ys, const float *zs, size_t count, float qx, float qy, float qz, float rad_sq, size_t *hits, float *dist_sq )
+    {
+        const __m256 vqx = _mm256_set1_ps( qx );
+        const __m256 vqy = _mm256_set1_ps( qy );
+        const __m256 vqz = _mm256_set1_ps( qz );
+        const __m256 vrad = _mm256_set1_ps( rad_sq );
+
+        size_t found = 0;
+        size_t i = 0;
+        for( ; i + 8 <= count; i += 8 )
+        {
+            __m256 dx = _mm256_sub_ps( _mm256_loadu_ps( xs + i ), vqx );
+            __m256 dy = _mm256_sub_ps( _mm256_loadu_ps( ys + i ), vqy );
+            __m256 dz = _mm256_sub_ps( _mm256_loadu_ps( zs + i ), vqz );
+            __m256 dist = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( dx, dx ), _mm256_mul_ps( dy, dy ) ), _mm256_mul_ps( dz, dz ) );
+
+            int mask = _mm256_movemask_ps( _mm256_cmp_ps( dist, vrad, _CMP_LE_OQ ) );
+            if( mask == 0 )
+                continue;
+
+            float lanes[8];
+            _mm256_storeu_ps( lanes, dist );
+            for( int lane = 0; lane < 8; ++lane )
+            {
+                if( mask & ( 1 << lane ) )
+                {
+                    hits[found] = i + lane;
+                    dist_sq[found] = lanes[lane];
+                    ++found;
+                }
+            }
+        }
+
+        return filter_scalar( xs, ys, zs, i, count, qx, qy, qz, rad_sq, hits, dist_sq, found );
+    }
+#elif defined(VERTDB_SIMD_SSE2)
+    template<>
+    inline size_t radius_kernel<double>::filter( const double *xs, const double *ys, const double *zs, size_t count, double qx, double qy, double qz, double rad_sq, size_t *hits, double *dist_sq )
+    {
+        const __m128d vqx = _mm_set1_pd( qx );
+        const __m128d vqy = _mm_set1_pd( qy );
+        const __m128d vqz = _mm_set1_pd( qz );
+        const __m128d vrad = _mm_set1_pd( rad_sq );
+
+        size_t found = 0;
+        size_t i = 0;
+        for( ; i + 2 <= count; i += 2 )
+        {
+            __m128d dx = _mm_sub_pd( _mm_loadu_pd( xs + i ), vqx );
+            __m128d dy = _mm_sub_pd( _mm_loadu_pd( ys + i ), vqy );
+            __m128d dz = _mm_sub_pd( _mm_loadu_pd( zs + i ), vqz );
+            __m128d dist = _mm_add_pd( _mm_add_pd( _mm_mul_pd( dx, dx ), _mm_mul_pd( dy, dy ) ), _mm_mul_pd( dz, dz ) );
+
+            int mask = _mm_movemask_pd( _mm_cmple_pd( dist, vrad ) );
+            if( mask == 0 )
+                continue;
+
+            double lanes[2];
+            _mm_storeu_pd( lanes, dist );
+            for( int lane = 0; lane < 2; ++lane )
+            {
+                if( mask & ( 1 << lane ) )
+                {
+                    hits[found] = i + lane;
+                    dist_sq[found] = lanes[lane];
+                    ++found;
+                }
+            }
+        }
+
+        return filter_scalar( xs, ys, zs, i, count, qx, qy, qz, rad_sq, hits, dist_sq, found );
+    }
+
+    template<>
+    inline size_t radius_kernel<float>::filter( const float *xs, const float *ys, const float *zs, size_t count, float qx, float qy, float qz, float rad_sq, size_t *hits, float *dist_sq )
+    {
+        const __m128 vqx = _mm_set1_ps( qx );
+        const __m128 vqy = _mm_set1_ps( qy );
+        const __m128 vqz = _mm_set1_ps( qz );
+        const __m128 vrad = _mm_set1_ps( rad_sq );
+
+        size_t found = 0;
+        size_t i = 0;
+        for( ; i + 4 <= count; i += 4 )
+        {
+            __m128 dx = _mm_sub_ps( _mm_loadu_ps( xs + i ), vqx );
+            __m128 dy = _mm_sub_ps( _mm_loadu_ps( ys + i ), vqy );
+            __m128 dz = _mm_sub_ps( _mm_loadu_ps( zs + i ), vqz );
+            __m128 dist = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) ), _mm_mul_ps( dz, dz ) );
+
+            int mask = _mm_movemask_ps( _mm_cmple_ps( dist, vrad ) );
+            if( mask == 0 )
+                continue;
+
+            float lanes[4];
+            _mm_storeu_ps( lanes, dist );
+            for( int lane = 0; lane < 4; ++lane )
+            {
+                if( mask & ( 1 << lane ) )
+                {
+                    hits[found] = i + lane;
+                    dist_sq[found] = lanes[lane];
+                    ++found;
+                }
+            }
+        }
+
+        return filter_scalar( xs, ys, zs, i, count, qx, qy, qz, rad_sq, hits, dist_sq, found );
+    }
+#endif
+};
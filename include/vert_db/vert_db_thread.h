@@ -4,55 +4,310 @@
 
 namespace vd
 {
+    // Persistent pool of worker threads shared by every parallel loop in vert_db.
+    //  Each worker owns a task queue, and idle workers steal from the others.
+    //  Work submitted from inside a pool task runs inline on the submitting thread,
+    //  so nested parallel regions never oversubscribe the machine.
+    class thread_pool
+    {
+    public:
+        typedef VERTDB_FUNCTION<void()> task_type;
+
+        static thread_pool& shared()
+        {
+            static thread_pool pool( VERTDB_THREAD_POOL_SIZE );
+            return pool;
+        }
+
+        explicit thread_pool( size_t thread_count = 0 )
+            : m_queues()
+            , m_workers()
+            , m_wake_mutex()
+            , m_wake()
+            , m_queued( 0 )
+            , m_next_queue( 0 )
+            , m_stopping( false )
+        {
+            start( thread_count );
+        }
+
+        ~thread_pool()
+        {
+            stop();
+        }
+
+        thread_pool( const thread_pool& ) = delete;
+        thread_pool& operator=( const thread_pool& ) = delete;
+
+        // Number of dedicated worker threads
+        size_t thread_count() const
+        {
+            return m_workers.size();
+        }
+
+        // Threads available to a parallel loop, counting the caller which helps while waiting
+        size_t concurrency() const
+        {
+            return m_workers.size() + 1;
+        }
+
+        // Restart with a new worker count (0 uses hardware concurrency).
+        //  Must not be called while work is in flight.
+        void resize( size_t thread_count )
+        {
+            stop();
+            start( thread_count );
+        }
+
+        // True while the calling thread is executing pool work
+        static bool in_parallel()
+        {
+            return parallel_flag();
+        }
+
+        void submit( task_type task )
+        {
+            if( m_queues.empty() )
+            {
+                run( task );
+                return;
+            }
+
+            // Count the task before any worker can see it, so claim() never takes m_queued below zero.
+            //  The two locks are never held together; steal() takes a queue's lock before m_wake_mutex.
+            {
+                lock_type lock( m_wake_mutex );
+                ++m_queued;
+            }
+
+            size_t index = m_next_queue.fetch_add( 1 ) % m_queues.size();
+            {
+                worker_queue &queue = *m_queues[index];
+                lock_type lock( queue.m_mutex );
+                queue.m_tasks.emplace_back( VERTDB_MOVE( task ) );
+            }
+            m_wake.notify_one();
+        }
+
+        // Run one queued task on the calling thread, if any is waiting
+        bool run_pending()
+        {
+            task_type task;
+            if( !steal( 0, task ) )
+                return false;
+
+            run( task );
+            return true;
+        }
+
+    protected:
+        struct worker_queue
+        {
+            mutex_type m_mutex;
+            VERTDB_DEQUE<task_type> m_tasks;
+        };
+
+        typedef VERTDB_UNIQUE_PTR<worker_queue> queue_handle;
+
+        static bool& parallel_flag()
+        {
+            static thread_local bool flag = false;
+            return flag;
+        }
+
+        // Marks the calling thread as running pool work until it goes out of scope,
+        //  so a task that throws still restores the flag
+        struct parallel_scope
+        {
+            parallel_scope()
+                : m_previous( parallel_flag() )
+            {
+                parallel_flag() = true;
+            }
+
+            ~parallel_scope()
+            {
+                parallel_flag() = m_previous;
+            }
+
+            bool m_previous;
+        };
+
+        static void run( task_type &task )
+        {
+            parallel_scope scope;
+            task();
+        }
+
+        void start( size_t thread_count )
+        {
+            if( thread_count == 0 )
+            {
+                // The thread that submits work also helps run it
+                thread_count = thread_type::hardware_concurrency();
+                thread_count = ( thread_count > 1 ) ? thread_count - 1 : 0;
+            }
+
+            m_stopping = false;
+            m_queued = 0;
+
+            for( size_t i = 0; i < thread_count; ++i )
+            {
+                m_queues.emplace_back( VERTDB_MAKE_UNIQUE<worker_queue>() );
+            }
+
+            for( size_t i = 0; i < thread_count; ++i )
+            {
+                m_workers.emplace_back( [=] { this->worker_func( i ); } );
+            }
+        }
+
+        void stop()
+        {
+            {
+                lock_type lock( m_wake_mutex );
+                m_stopping = true;
+            }
+            m_wake.notify_all();
+
+            for( auto &worker : m_workers )
+            {
+                worker.join();
+            }
+
+            m_workers.clear();
+            m_queues.clear();
+        }
+
+        // Owner takes its newest task, thieves take the oldest from other queues
+        bool pop( size_t index, task_type &task )
+        {
+            worker_queue &queue = *m_queues[index];
+            lock_type lock( queue.m_mutex );
+            if( queue.m_tasks.empty() )
+                return false;
+
+            task = VERTDB_MOVE( queue.m_tasks.back() );
+            queue.m_tasks.pop_back();
+            return true;
+        }
+
+        bool steal( size_t start, task_type &task )
+        {
+            size_t count = m_queues.size();
+            for( size_t i = 0; i < count; ++i )
+            {
+                worker_queue &queue = *m_queues[( start + i ) % count];
+                lock_type lock( queue.m_mutex );
+                if( !queue.m_tasks.empty() )
+                {
+                    task = VERTDB_MOVE( queue.m_tasks.front() );
+                    queue.m_tasks.pop_front();
+                    return claim();
+                }
+            }
+
+            return false;
+        }
+
+        bool claim()
+        {
+            lock_type lock( m_wake_mutex );
+            --m_queued;
+            return true;
+        }
+
+        void worker_func( size_t index )
+        {
+            while( true )
+            {
+                task_type task;
+                if( ( pop( index, task ) && claim() ) || steal( index + 1, task ) )
+                {
+                    run( task );
+                    continue;
+                }
+
+                unique_lock_type lock( m_wake_mutex );
+                m_wake.wait( lock, [this] { return m_stopping || ( m_queued > 0 ); } );
+                if( m_stopping && ( m_queued == 0 ) )
+                    break;
+            }
+        }
+
+        VERTDB_BUCKET<queue_handle> m_queues;
+        thread_collection m_workers;
+
+        mutex_type m_wake_mutex;
+        condition_type m_wake;
+        size_t m_queued;
+
+        VERTDB_ATOMIC<size_t> m_next_queue;
+        bool m_stopping;
+    };
+
     template<typename Func, typename In, typename Out>
     class threaded_processor
     {
     public:
-        threaded_processor( Func &func, const In &begin, const In &end, Out &results, size_t thread_count = 0 )
+        threaded_processor( Func &func, const In &begin, const In &end, Out &results, size_t thread_count = 0, thread_pool &pool = thread_pool::shared() )
             : m_result_mutex()
-            , m_threads()
+            , m_done_mutex()
+            , m_done()
+            , m_pending( 0 )
+            , m_pool( pool )
             , m_func(func)
             , m_results(results)
         {
-            if( thread_count == 0 )
-                thread_count = thread_type::hardware_concurrency();
-        
-            if( thread_count == 0 )
-                thread_count = 1;
-        
             size_t item_count = VERTDB_ITERATOR_DISTANCE( begin, end );
-            if( item_count < thread_count )
-                thread_count = item_count;
-        
-            if( item_count > 0 )
-            {
-                size_t stride = item_count / thread_count;
-        
-                for( size_t i = 0; i < thread_count; ++i )
-                {
-                    In start = begin;
-                    In stop = begin;
-                    VERTDB_ITERATOR_ADVANCE( start, stride*i );
-        
-                    if( i == ( thread_count - 1 ) )
-                        stop = end;
-                    else
-                        VERTDB_ITERATOR_ADVANCE( stop, stride*( i + 1 ) );
-        
-                    m_threads.emplace_back( [=] { this->thread_func( start, stop ); } );
-                }
+            if( item_count == 0 )
+                return;
+
+            // Nested regions and single threaded pools run inline on the caller
+            if( thread_pool::in_parallel() || ( m_pool.thread_count() == 0 ) )
+            {
+                thread_func( begin, end );
+                return;
+            }
+
+            if( thread_count == 0 )
+                thread_count = m_pool.concurrency();
+
+            size_t chunk_count = thread_count * VERTDB_THREAD_CHUNKS;
+            if( item_count < chunk_count )
+                chunk_count = item_count;
+
+            size_t stride = item_count / chunk_count;
+            m_pending = chunk_count;
+
+            In start = begin;
+            for( size_t i = 0; i < chunk_count; ++i )
+            {
+                In stop = start;
+                if( i == ( chunk_count - 1 ) )
+                    stop = end;
+                else
+                    VERTDB_ITERATOR_ADVANCE( stop, stride );
+
+                m_pool.submit( [=] { this->chunk_func( start, stop ); } );
+                start = stop;
             }
         }
-        
+
+        ~threaded_processor()
+        {
+            join();
+        }
+
         void thread_func( const In &begin, const In &end )
         {
             Out thread_results;
-            
+
             for( auto it = begin; it != end; ++it )
             {
                 m_func( *it, thread_results );
             }
-        
+
             if( !thread_results.empty() )
             {
                 lock_type guard( m_result_mutex );
@@ -60,18 +315,38 @@ namespace vd
             }
         }
 
+        // Help run queued work until every chunk of this processor has finished
         void join()
         {
-            for( auto &thread : m_threads )
+            while( m_pending > 0 )
             {
-                thread.join();
+                if( m_pool.run_pending() )
+                    continue;
+
+                unique_lock_type lock( m_done_mutex );
+                m_done.wait( lock, [this] { return m_pending == 0; } );
             }
+
+            // The last chunk notifies while holding the lock, so wait for it to let go
+            lock_type lock( m_done_mutex );
         }
 
     protected:
+        void chunk_func( const In &begin, const In &end )
+        {
+            thread_func( begin, end );
+
+            lock_type lock( m_done_mutex );
+            if( --m_pending == 0 )
+                m_done.notify_all();
+        }
+
         mutex_type m_result_mutex;
-        thread_collection m_threads;
+        mutex_type m_done_mutex;
+        condition_type m_done;
+        VERTDB_ATOMIC<size_t> m_pending;
+        thread_pool &m_pool;
         Func &m_func;
         Out &m_results;
     };
-};
\ No newline at end of file
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "vert_db/vert_db.h"
+#include "vert_db/vert_db_mapping.h"
 
 namespace vd
 {
@@ -12,10 +13,24 @@ namespace vd
         typedef typename db_type::key_type key_type;
         typedef VERTDB_BUCKET<key_type> frontier_type;
         typedef typename frontier_type::iterator frontier_iterator;
+        typedef transfer_mapping<key_type, typename db_type::scalar> mapping_type;
 
         virtual ~transfer_resolver() {}
 
         virtual frontier_type resolve( const db_type &context, const frontier_iterator &begin, const frontier_iterator &end, db_type &results ) const = 0;
+
+        // True if record() captures everything this resolver does in a transfer_mapping
+        virtual bool recordable() const
+        {
+            return false;
+        }
+
+        // resolve(), also adding a row to mapping for each key resolved.
+        //  Resolvers that are not recordable just resolve.
+        virtual frontier_type record( const db_type &context, const frontier_iterator &begin, const frontier_iterator &end, db_type &results, mapping_type & ) const
+        {
+            return resolve( context, begin, end, results );
+        }
     };
 
 
@@ -30,6 +45,7 @@ namespace vd
         typedef VERTDB_UNIQUE_PTR<resolver_type> resolver_handle;
         typedef VERTDB_BUCKET<resolver_handle> resolver_collection;
         typedef VERTDB_BUCKET<key_type> frontier_type;
+        typedef typename resolver_type::mapping_type mapping_type;
 
         inline vert_db_type& vert_db()
         {
@@ -64,6 +80,52 @@ namespace vd
             return true;
         }
 
+        // apply(), recording where every destination key drew its data from into mapping
+        bool record( vert_db_type &results, mapping_type &mapping )
+        {
+            mapping.clear();
+            frontier_type frontier( results.begin(), results.end() );
+
+            for( auto& resolver : m_resolvers )
+            {
+                frontier = resolver->record( vert_db(), frontier.begin(), frontier.end(), results, mapping );
+            }
+
+            return true;
+        }
+
+        // Repeat a recorded transfer from this db's current channels, without any spatial queries.
+        //  Resolvers that could not be recorded (such as flood fills, which read results) run again
+        //  on the keys mapping does not cover, so they should come after every recordable one.
+        bool replay( const mapping_type &mapping, vert_db_type &results )
+        {
+            mapping.apply( vert_db(), results );
+
+            VERTDB_BUCKET<bool> mapped;
+            for( const auto &key : mapping.keys() )
+            {
+                if( key >= mapped.size() )
+                    mapped.resize( key + 1, false );
+
+                mapped[key] = true;
+            }
+
+            frontier_type frontier;
+            for( const auto &key : results )
+            {
+                if( ( key >= mapped.size() ) || !mapped[key] )
+                    frontier.emplace_back( key );
+            }
+
+            for( auto& resolver : m_resolvers )
+            {
+                if( !resolver->recordable() )
+                    frontier = resolver->resolve( vert_db(), frontier.begin(), frontier.end(), results );
+            }
+
+            return true;
+        }
+
     protected:
         vert_db_type m_db;
         resolver_collection m_resolvers;
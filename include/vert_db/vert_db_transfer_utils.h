@@ -8,21 +8,15 @@ namespace vd
     class transfer_resolver_base : public transfer_resolver<T>
     {
     public:
+        typedef typename db_type::def_type def_type;
+        typedef typename db_type::staged_edit staged_edit;
+        typedef typename db_type::staged_collection staged_collection;
+
         transfer_resolver_base( item_flags to_set )
             : m_set( to_set )
         {
         }
 
-        bool apply( const db_type &context, const key_type &context_key, db_type &results, const key_type &results_key ) const
-        {
-            auto to_set = results.make_def();
-            to_set.flags |= m_set;
-            context.gather( context_key, to_set );
-
-            results.update_atomic( results_key, to_set );
-            return true;
-        }
-
     protected:
         item_flags m_set;
     };
@@ -32,40 +26,96 @@ namespace vd
     {
     public:
         typedef transfer_resolver_threaded<T> self_type;
+        typedef typename mapping_type::rule_type rule_type;
+        typedef typename mapping_type::key_collection key_collection;
+        typedef typename mapping_type::scalar_collection scalar_collection;
+
+        // Source keys and kernel weights one destination key draws from
+        struct source_row
+        {
+            key_type m_key;
+            key_collection m_sources;
+            scalar_collection m_weights;
+        };
+
+        typedef VERTDB_BUCKET<source_row> row_collection;
 
         transfer_resolver_threaded( item_flags to_set )
             : transfer_resolver_base( to_set )
         {
         }
 
-        virtual bool resolve_vert( const db_type &context, const key_type &key, db_type &results ) const = 0;
+        // Fill row for key, only reading results; return false to leave key for the next resolver
+        virtual bool find_sources( const db_type &context, const key_type &key, const db_type &results, source_row &row ) const = 0;
+
+        // How rows from this resolver are blended.  Defaults to copying m_set from the one source.
+        virtual rule_type rule() const
+        {
+            return rule_type{ m_set, false, 0, 0, false };
+        }
+
+        bool recordable() const override
+        {
+            return true;
+        }
 
         frontier_type resolve( const db_type &context, const frontier_iterator &begin, const frontier_iterator &end, db_type &results ) const override
         {
-            frontier_type next;
+            mapping_type mapping;
+            return record( context, begin, end, results, mapping );
+        }
+
+        // Workers only read results and collect source rows in per-thread buffers.
+        //  After the join the rows are added to mapping, then blended and committed in one pass.
+        frontier_type record( const db_type &context, const frontier_iterator &begin, const frontier_iterator &end, db_type &results, mapping_type &mapping ) const override
+        {
+            row_collection rows;
+            rows.reserve( VERTDB_ITERATOR_DISTANCE( begin, end ) );
 
             processor_func runner{ context, *this, results };
-            transfer_processor processor( runner, begin, end, next );
+            transfer_processor processor( runner, begin, end, rows );
             processor.join();
 
-            return next;
+            size_t rule_index = mapping.add_rule( rule() );
+            size_t first = mapping.size();
+
+            frontier_type unresolved;
+            for( const auto &row : rows )
+            {
+                if( !mapping.add_row( row.m_key, rule_index, row.m_sources, row.m_weights ) )
+                    unresolved.emplace_back( row.m_key );
+            }
+
+            mapping.apply( context, results, first, mapping.size() );
+            return unresolved;
         }
 
     protected:
+        // find_sources for resolvers that copy from one matching vert
+        static bool single_source( const key_type &context_key, source_row &row )
+        {
+            row.m_sources.assign( 1, context_key );
+            row.m_weights.assign( 1, 1 );
+            return true;
+        }
+
         struct processor_func
         {
-            void operator()( const key_type &key, frontier_type &collector )
+            void operator()( const key_type &key, row_collection &collector )
             {
-                if( !m_resolver.resolve_vert( m_context, key, m_results ) )
-                    collector.emplace_back( key );
+                source_row row{ key };
+                if( !m_resolver.find_sources( m_context, key, m_results, row ) )
+                    row.m_sources.clear();
+
+                collector.emplace_back( VERTDB_MOVE( row ) );
             }
 
             const db_type &m_context;
             const self_type &m_resolver;
-            db_type &m_results;
+            const db_type &m_results;
         };
 
-        typedef threaded_processor<processor_func, typename frontier_type::iterator, frontier_type> transfer_processor;
+        typedef threaded_processor<processor_func, typename frontier_type::iterator, row_collection> transfer_processor;
     };
 
     template<typename T>
@@ -78,7 +128,7 @@ namespace vd
         {
         }
 
-        bool resolve_vert( const db_type &context, const key_type &key, db_type &results ) const override
+        bool find_sources( const db_type &context, const key_type &key, const db_type &results, source_row &row ) const override
         {
             auto id = results.id( key );
 
@@ -91,7 +141,7 @@ namespace vd
             if( distance > m_tolerance )
                 return false;
 
-            return apply( context, found_key, results, key );
+            return single_source( found_key, row );
         }
 
     protected:
@@ -108,31 +158,15 @@ namespace vd
         {
         }
 
-        bool resolve_vert( const db_type &context, const key_type &key, db_type &results ) const override
+        bool find_sources( const db_type &context, const key_type &key, const db_type &results, source_row &row ) const override
         {
             auto result_pos = results.position( key );
-            auto found = context.find_position( result_pos, m_tolerance );
-
-            if( found.empty() )
-                return false;
-
-            db_type::scalar best_dist = VERTDB_NUMERIC_LIMITS<db_type::scalar>::max();
-            db_type::key_type best_key = found[0];
-
-            for( const auto &found_key : found )
-            {
-                db_type::scalar dist = context.distance_to( result_pos, found_key );
-                if( dist < best_dist )
-                {
-                    best_dist = dist;
-                    best_key = found_key;
-                }
-            }
+            auto best_key = context.find_nearest_position( result_pos, m_tolerance );
 
             if( best_key == c_invalid_vert_id )
                 return false;
 
-            return apply( context, best_key, results, key );
+            return single_source( best_key, row );
         }
 
     protected:
@@ -150,38 +184,28 @@ namespace vd
         {
         }
 
-        bool resolve_vert( const db_type &context, const key_type &key, db_type &results ) const override
+        bool find_sources( const db_type &context, const key_type &key, const db_type &results, source_row &row ) const override
         {
             auto result_pos = results.position( key );
             auto result_norm = results.normal( key );
-            auto found = context.find_position( result_pos, m_position_tolerance );
             vd::real angle_tolerance = 1 - m_normal_tolerance;
 
-            if( found.empty() )
-                return false;
-
-            db_type::scalar best_dist = VERTDB_NUMERIC_LIMITS<db_type::scalar>::max();
-            db_type::key_type best_key = found[0];
-
-            for( const auto &found_key : found )
+            auto normal_check = [&]( const key_type &found_key )
             {
                 auto compare_normal = context.normal( found_key );
                 vd::real NdotN = dot( result_norm, compare_normal );
-                if( angle_tolerance >= NdotN )
-                {
-                    db_type::scalar dist = context.distance_to( result_pos, found_key );
-                    if( dist < best_dist )
-                    {
-                        best_dist = dist;
-                        best_key = found_key;
-                    }
-                }
-            }
+                return angle_tolerance >= NdotN;
+            };
+
+            // Prefer the nearest vert passing the normal check, but fall back to any in range
+            auto best_key = context.find_nearest_position( result_pos, m_position_tolerance, normal_check );
+            if( best_key == c_invalid_vert_id )
+                best_key = context.find_nearest_position( result_pos, m_position_tolerance );
 
             if( best_key == c_invalid_vert_id )
                 return false;
 
-            return apply( context, best_key, results, key );
+            return single_source( best_key, row );
         }
 
     protected:
@@ -199,31 +223,15 @@ namespace vd
         {
         }
 
-        bool resolve_vert( const db_type &context, const key_type &key, db_type &results ) const override
+        bool find_sources( const db_type &context, const key_type &key, const db_type &results, source_row &row ) const override
         {
             auto result_pos = results.uvw( key );
-            auto found = context.find_uvw( result_pos, m_tolerance );
-
-            if( found.empty() )
-                return false;
-
-            db_type::scalar best_dist = VERTDB_NUMERIC_LIMITS<db_type::scalar>::max();
-            db_type::key_type best_key = found.first();
-
-            for( const auto &found_key : found )
-            {
-                db_type::scalar dist = context.distance_to_uvw( results_pos, found_key );
-                if( dist < best_dist )
-                {
-                    best_dist = dist;
-                    best_key = found_key;
-                }
-            }
+            auto best_key = context.find_nearest_uvw( result_pos, m_tolerance );
 
             if( best_key == c_invalid_vert_id )
                 return false;
 
-            return apply( context, best_key, results, key );
+            return single_source( best_key, row );
         }
 
     protected:
@@ -243,52 +251,17 @@ namespace vd
         {
         }
 
-        bool resolve_vert( const db_type &context, const key_type &key, db_type &results ) const override
+        bool find_sources( const db_type &context, const key_type &key, const db_type &results, source_row &row ) const override
         {
-            auto to_set = results.make_def();
-
             auto result_pos = results.position( key );
 
-            auto verts = context.find_position_sorted( result_pos, m_radius );
-            if( verts.empty() )
-                return false;
-
-            size_t best_key = verts.front();
-
-            if( flag_is_set( m_set, k_item_id ) )
-                to_set.set_id( context.id(best_key) );
-
-            if( flag_is_set( m_set, k_item_position ) )
-                to_set.set_position( result_pos );
-
-            // TODO: filter normal similar to colors, ut guarantee unit length.
-            if( flag_is_set( m_set, k_item_normal ) )
-                to_set.set_normal( context.normal(best_key) );
-
-            // TODO: Intelligently filter UVW somehow? Barycentric?
-            if( flag_is_set( m_set, k_item_uvw ) )
-                to_set.set_position( context.uvw( best_key ) );
-
-            if( flag_is_set( m_set, k_item_color ) )
-                to_set.set_color( context.sample_color(result_pos, m_radius) );
-
-            if( flag_is_set( m_set, k_item_weights ) )
-            {
-                auto weights = context.find_weights( result_pos, m_radius, m_weight_total, m_weight_clip, m_weight_normalize );
-                to_set.set_weights( weights );
-            }
-
-            // TODO: This can technically create one-way connects.  Maybe shouldn't?
-            //       This should be consistent with ID query.
-            //       Problem comes with multiple items sharing an ID.
-            //       ID dupes should shake out during insert to results DB though.
-            if( flag_is_set( m_set, k_item_connects ) )
-            {
-                to_set.set_connects( context.connects( best_key ) );
-            }
+            // One query for every channel; the kernel weights are shared by all of them
+            return context.find_filter( result_pos, m_radius, row.m_sources, row.m_weights );
+        }
 
-            results.update_atomic( key, to_set );
-            return true;
+        rule_type rule() const override
+        {
+            return rule_type{ m_set, true, m_weight_total, m_weight_clip, m_weight_normalize };
         }
 
     protected:
@@ -299,15 +272,20 @@ namespace vd
     };
 
 
+    // Fills unresolved verts from their resolved neighbours, one ring of verts per generation.
+    //  Only verts next to ones resolved in the previous generation are evaluated, and neighbour
+    //  values come from flat per-key channel arrays, so each generation costs the size of its wavefront.
+    //  Positions, normals, uvws, colors and weights are averaged; ids and connects are not filled.
     template<typename T>
     class transfer_flood_fill : public transfer_resolver_base<T>
     {
         typedef transfer_flood_fill<T> self_type;
-        typedef typename db_type::key_type key_type;
-        typedef VERTDB_PAIR< key_type, db_item_def<T> > generation_item;
-        typedef VERTDB_BUCKET< generation_item > generation_type;
-        typedef typename db_type::def_type def_type;
-        typedef VERTDB_BUCKET< def_type > def_collection;
+        typedef typename db_type::point_type point_type;
+        typedef typename db_type::key_collection key_collection;
+        typedef typename db_type::adjacency_type adjacency_type;
+        typedef typename db_type::traversal_type traversal_type;
+        typedef VERTDB_BUCKET<point_type> point_collection;
+        typedef VERTDB_BUCKET<indexed_weights> weights_collection;
 
     public:
         transfer_flood_fill( item_flags to_set, int depth=-1 )
@@ -318,91 +296,485 @@ namespace vd
 
         frontier_type resolve( const db_type &context, const frontier_iterator &begin, const frontier_iterator &end, db_type &results ) const override
         {
-            frontier_type frontier( begin, end );
-            frontier_type next;
-            int generations = 0;
+            const adjacency_type &graph = results.adjacency();
+            size_t key_count = graph.size();
+            item_flags fill = m_set & ( k_item_position | k_item_normal | k_item_uvw | k_item_color | k_item_weights );
 
-            while( !frontier.empty() )
+            // Frontier verts that already hold every filled channel seed the fill instead of waiting on it
+            fill_state state( results, fill, key_count );
+            for( auto it = begin; it != end; ++it )
             {
-                next.clear();
+                if( ( *it < key_count ) && ( state.m_status[*it] != k_fill_resolved ) )
+                    state.m_status[*it] = k_fill_pending;
+            }
 
-                mutex_type generation_mutex;
-                generation_type generation;
+            // The first wave is every pending vert already touching a resolved one
+            frontier_type wave;
+            for( auto it = begin; it != end; ++it )
+            {
+                if( ( *it < key_count ) && state.touches_resolved( graph, *it ) )
+                    wave.emplace_back( *it );
+            }
 
-                processor_func runner{ results, *this, generation_mutex, generation };
-                transfer_processor processor( runner, frontier.begin(), frontier.end(), next );
-                processor.join();
+            frontier_type filled;
+            frontier_type next;
+            traversal_type marks;
+            int generations = 0;
 
-                bool found_any = !generation.empty();
+            while( !wave.empty() )
+            {
+                // Each wave only reads verts resolved before it, so its verts fill independently
+                fill_func func{ graph, state };
+                key_collection unused;
+                fill_processor processor( func, wave.begin(), wave.end(), unused );
+                processor.join();
 
-                for( const auto &item : generation )
+                for( const auto &key : wave )
                 {
-                    results.update( item.first, item.second );
+                    state.m_status[key] = k_fill_resolved;
+                    filled.emplace_back( key );
                 }
 
-                // Only loop if there was meaningful progress
-                if( found_any && ( frontier != next ) )
-                    frontier = next;
-                else
-                    break;
-
                 ++generations;
-                if( ( m_depth > 0 ) && (generations >= m_depth) )
+                if( ( m_depth > 0 ) && ( generations >= m_depth ) )
                     break;
+
+                // Advance to the pending neighbours of what just resolved
+                next.clear();
+                marks.begin( key_count );
+                for( const auto &key : wave )
+                {
+                    for( const auto &neighbour : graph.neighbours( key ) )
+                    {
+                        if( ( state.m_status[neighbour] == k_fill_pending ) && marks.visit( neighbour ) )
+                            next.emplace_back( neighbour );
+                    }
+                }
+
+                wave.swap( next );
+            }
+
+            // Every filled vert is committed in one batch
+            staged_collection staged;
+            staged.reserve( filled.size() );
+            for( const auto &key : filled )
+            {
+                auto def = results.make_def();
+                state.store( key, fill, results.bones(), def );
+                staged.emplace_back( key, VERTDB_MOVE( def ) );
             }
 
-            return next;
+            results.update_batch( staged.begin(), staged.end() );
+
+            frontier_type unresolved;
+            for( auto it = begin; it != end; ++it )
+            {
+                if( ( *it >= key_count ) || ( state.m_status[*it] != k_fill_resolved ) )
+                    unresolved.emplace_back( *it );
+            }
+
+            return unresolved;
         }
 
-        bool resolve_vert(const key_type &key, const db_type &context, mutex_type &mutex, generation_type &generation) const
+    protected:
+        enum fill_status : unsigned char
         {
-            auto connects = context.connects( key );
+            k_fill_none,
+            k_fill_pending,
+            k_fill_resolved,
+        };
 
-            def_collection connect_defs;
-            for( const auto &id : connects )
+        // Channel values by key for every resolved vert, plus where each vert is in the fill
+        struct fill_state
+        {
+            fill_state( const db_type &results, item_flags fill, size_t key_count )
+                : m_status( key_count, k_fill_none )
+                , m_positions( flag_is_set( fill, k_item_position ) ? key_count : 0 )
+                , m_normals( flag_is_set( fill, k_item_normal ) ? key_count : 0 )
+                , m_uvws( flag_is_set( fill, k_item_uvw ) ? key_count : 0 )
+                , m_colors( flag_is_set( fill, k_item_color ) ? key_count : 0 )
+                , m_weights( flag_is_set( fill, k_item_weights ) ? key_count : 0 )
             {
-                auto connect_def = context.make_def();
-                if( context.gather( id, connect_def ) )
+                for( const auto &key : results )
                 {
-                    if( flag_is_set( connect_def.flags, m_set ) )
-                        connect_defs.emplace_back( connect_def );
+                    if( ( key >= key_count ) || ( ( results.channels( key ) & fill ) != fill ) )
+                        continue;
+
+                    m_status[key] = k_fill_resolved;
+                    if( !m_positions.empty() )
+                        m_positions[key] = results.position( key );
+
+                    if( !m_normals.empty() )
+                        m_normals[key] = results.normal( key );
+
+                    if( !m_uvws.empty() )
+                        m_uvws[key] = results.uvw( key );
+
+                    if( !m_colors.empty() )
+                        m_colors[key] = results.color( key );
+
+                    if( !m_weights.empty() )
+                        m_weights[key] = results.weight_indices( key );
                 }
             }
 
-            // Needs valid connections to flood fill
-            if( connect_defs.empty() )
+            bool touches_resolved( const adjacency_type &graph, const key_type &key ) const
+            {
+                for( const auto &neighbour : graph.neighbours( key ) )
+                {
+                    if( m_status[neighbour] == k_fill_resolved )
+                        return true;
+                }
+
                 return false;
+            }
+
+            // Average the resolved neighbours of key into its slots
+            void average( const adjacency_type &graph, const key_type &key )
+            {
+                point_type position{};
+                point_type normal{};
+                point_type uvw{};
+                point_type color{};
+                indexed_weights weights;
+                size_t count = 0;
+
+                for( const auto &neighbour : graph.neighbours( key ) )
+                {
+                    if( m_status[neighbour] != k_fill_resolved )
+                        continue;
+
+                    ++count;
+                    if( !m_positions.empty() )
+                        position = position + m_positions[neighbour];
+
+                    if( !m_normals.empty() )
+                        normal = normal + m_normals[neighbour];
+
+                    if( !m_uvws.empty() )
+                        uvw = uvw + m_uvws[neighbour];
+
+                    if( !m_colors.empty() )
+                        color = color + m_colors[neighbour];
 
-            auto combined_def = combine_defs( connect_defs.begin(), connect_defs.end() );
-            combined_def.flags = m_set;
-            generation_item item( key, combined_def );
+                    if( !m_weights.empty() )
+                        add_weights( weights, m_weights[neighbour] );
+                }
+
+                if( count == 0 )
+                    return;
+
+                vd::real factor = vd::real( 1 ) / count;
+                if( !m_positions.empty() )
+                    m_positions[key] = position * factor;
+
+                if( !m_normals.empty() )
+                    m_normals[key] = normal * factor;
+
+                if( !m_uvws.empty() )
+                    m_uvws[key] = uvw * factor;
+
+                if( !m_colors.empty() )
+                    m_colors[key] = color * factor;
+
+                if( !m_weights.empty() )
+                {
+                    for( auto &weight : weights )
+                    {
+                        weight.second *= factor;
+                    }
+
+                    m_weights[key] = VERTDB_MOVE( weights );
+                }
+            }
 
+            void store( const key_type &key, item_flags fill, const bone_palette &bones, def_type &def ) const
             {
-                lock_type lock( mutex );
-                generation.emplace_back( item );
+                if( flag_is_set( fill, k_item_position ) )
+                    def.set_position( m_positions[key] );
+
+                if( flag_is_set( fill, k_item_normal ) )
+                    def.set_normal( m_normals[key] );
+
+                if( flag_is_set( fill, k_item_uvw ) )
+                    def.set_uvw( m_uvws[key] );
+
+                if( flag_is_set( fill, k_item_color ) )
+                    def.set_color( m_colors[key] );
+
+                if( flag_is_set( fill, k_item_weights ) )
+                    def.set_weights( bones.resolve( m_weights[key] ) );
             }
 
-            return true;
+            static void add_weights( indexed_weights &results, const indexed_weights &weights )
+            {
+                for( const auto &weight : weights )
+                {
+                    auto found = results.begin();
+                    while( ( found != results.end() ) && ( found->first != weight.first ) )
+                        ++found;
+
+                    if( found == results.end() )
+                        results.emplace_back( weight );
+                    else
+                        found->second += weight.second;
+                }
+            }
+
+            VERTDB_BUCKET<unsigned char> m_status;
+            point_collection m_positions;
+            point_collection m_normals;
+            point_collection m_uvws;
+            point_collection m_colors;
+            weights_collection m_weights;
+        };
+
+        struct fill_func
+        {
+            void operator()( const key_type &key, key_collection & )
+            {
+                m_state.average( m_graph, key );
+            }
+
+            const adjacency_type &m_graph;
+            fill_state &m_state;
+        };
+
+        typedef threaded_processor<fill_func, typename frontier_type::iterator, key_collection> fill_processor;
+
+        int m_depth;
+    };
+
+
+    // Fills unresolved verts from the resolved verts nearest to them along the mesh.
+    //  One multi-source Dijkstra over edge-length weighted connects, seeded at distance 0 from every
+    //  resolved vert, finds up to source_count nearest seeds for each vert in O(E log V).  Each vert
+    //  then blends its seeds by inverse geodesic distance.  Normals, uvws, colors and weights are
+    //  blended; positions give the edge lengths so they are not filled, and neither are ids or connects.
+    template<typename T>
+    class transfer_geodesic_fill : public transfer_resolver_base<T>
+    {
+        typedef transfer_geodesic_fill<T> self_type;
+        typedef typename db_type::scalar scalar;
+        typedef typename db_type::point_type point_type;
+        typedef typename db_type::adjacency_type adjacency_type;
+        typedef VERTDB_BUCKET<point_type> point_collection;
+        typedef VERTDB_BUCKET<scalar> scalar_collection;
+
+    public:
+        // max_distance limits how far along the mesh a seed reaches, where 0 is unlimited
+        transfer_geodesic_fill( item_flags to_set, size_t source_count=3, vd::real max_distance=0, size_t weight_total=0, vd::real weight_clip=.05f, bool weight_normalize=true )
+            : transfer_resolver_base( to_set )
+            , m_source_count( source_count > 0 ? source_count : 1 )
+            , m_max_distance( max_distance )
+            , m_weight_total( weight_total )
+            , m_weight_clip( weight_clip )
+            , m_weight_normalize( weight_normalize )
+        {
+        }
+
+        frontier_type resolve( const db_type &context, const frontier_iterator &begin, const frontier_iterator &end, db_type &results ) const override
+        {
+            const adjacency_type &graph = results.adjacency();
+            size_t key_count = graph.size();
+            item_flags fill = m_set & ( k_item_normal | k_item_uvw | k_item_color | k_item_weights );
+
+            path_state paths( key_count, m_source_count );
+            point_collection positions( key_count );
+            for( const auto &key : results )
+            {
+                if( key >= key_count )
+                    continue;
+
+                positions[key] = results.position( key );
+                if( ( results.channels( key ) & fill ) == fill )
+                    paths.m_status[key] = k_path_seed;
+            }
+
+            // Frontier verts that already hold every filled channel seed the fill instead of waiting on it
+            for( auto it = begin; it != end; ++it )
+            {
+                if( ( *it < key_count ) && ( paths.m_status[*it] != k_path_seed ) )
+                    paths.m_status[*it] = k_path_pending;
+            }
+
+            path_heap heap;
+            for( size_t key = 0; key < key_count; ++key )
+            {
+                if( paths.m_status[key] == k_path_seed )
+                    heap.emplace_back( path_entry{ 0, key_type( key ), key_type( key ) } );
+            }
+
+            VERTDB_HEAP_MAKE( heap.begin(), heap.end(), path_greater() );
+
+            // A vert can be reached once per seed, but only its nearest source_count paths go any further
+            while( !heap.empty() )
+            {
+                VERTDB_HEAP_POP( heap.begin(), heap.end(), path_greater() );
+                path_entry entry = heap.back();
+                heap.pop_back();
+
+                if( ( paths.m_status[entry.m_key] == k_path_pending ) && !paths.add( entry ) )
+                    continue;
+
+                for( const auto &neighbour : graph.neighbours( entry.m_key ) )
+                {
+                    if( ( paths.m_status[neighbour] != k_path_pending ) || !paths.accepts( neighbour, entry.m_source ) )
+                        continue;
+
+                    point_type between = positions[neighbour] - positions[entry.m_key];
+                    scalar distance = entry.m_distance + sqrt( dot( between, between ) );
+                    if( ( m_max_distance > 0 ) && ( distance > m_max_distance ) )
+                        continue;
+
+                    heap.emplace_back( path_entry{ distance, neighbour, entry.m_source } );
+                    VERTDB_HEAP_PUSH( heap.begin(), heap.end(), path_greater() );
+                }
+            }
+
+            frontier_type filled;
+            frontier_type unresolved;
+            for( auto it = begin; it != end; ++it )
+            {
+                if( ( *it < key_count ) && ( paths.m_status[*it] == k_path_pending ) && ( paths.m_counts[*it] > 0 ) )
+                {
+                    paths.weigh( *it );
+                    filled.emplace_back( *it );
+                }
+                else if( ( *it >= key_count ) || ( paths.m_status[*it] != k_path_seed ) )
+                {
+                    unresolved.emplace_back( *it );
+                }
+            }
+
+            // Blending only reads seeds, so every filled vert blends independently and commits in one batch
+            staged_collection staged;
+            staged.reserve( filled.size() );
+
+            blend_func func{ *this, paths, results, fill };
+            blend_processor processor( func, filled.begin(), filled.end(), staged );
+            processor.join();
+
+            results.update_batch( staged.begin(), staged.end() );
+            return unresolved;
         }
 
     protected:
-        struct processor_func
+        enum path_status : unsigned char
+        {
+            k_path_none,
+            k_path_pending,
+            k_path_seed,
+        };
+
+        struct path_entry
         {
-            void operator()( const key_type &key, frontier_type &collector )
+            scalar m_distance;
+            key_type m_key;
+            key_type m_source;
+        };
+
+        // Orders the heap nearest first
+        struct path_greater
+        {
+            bool operator()( const path_entry &a, const path_entry &b ) const
             {
-                if( !m_resolver.resolve_vert( key, m_context, m_generation_mutex, m_generation ) )
-                    collector.emplace_back( key );
+                return a.m_distance > b.m_distance;
             }
+        };
 
-            const db_type &m_context;
-            const self_type &m_resolver;
+        typedef VERTDB_BUCKET<path_entry> path_heap;
 
-            mutex_type &m_generation_mutex;
-            generation_type &m_generation;
+        // Nearest seeds found so far for every pending vert, source_count slots per key.
+        //  Paths come off the heap in distance order, so each key's seeds are sorted nearest first.
+        struct path_state
+        {
+            path_state( size_t key_count, size_t source_count )
+                : m_status( key_count, k_path_none )
+                , m_counts( key_count, 0 )
+                , m_sources( key_count * source_count )
+                , m_distances( key_count * source_count )
+                , m_source_count( source_count )
+            {
+            }
+
+            // True if key has a free slot and has not already been reached from source
+            bool accepts( const key_type &key, const key_type &source ) const
+            {
+                size_t first = key * m_source_count;
+                size_t count = m_counts[key];
+                if( count >= m_source_count )
+                    return false;
+
+                for( size_t i = first; i < first + count; ++i )
+                {
+                    if( m_sources[i] == source )
+                        return false;
+                }
+
+                return true;
+            }
+
+            bool add( const path_entry &entry )
+            {
+                if( !accepts( entry.m_key, entry.m_source ) )
+                    return false;
+
+                size_t slot = ( entry.m_key * m_source_count ) + m_counts[entry.m_key]++;
+                m_sources[slot] = entry.m_source;
+                m_distances[slot] = entry.m_distance;
+                return true;
+            }
+
+            // Turn the distances of key into inverse distance weights.
+            //  A seed at no distance, such as a welded duplicate, is taken on its own.
+            void weigh( const key_type &key )
+            {
+                size_t first = key * m_source_count;
+                if( m_distances[first] <= 0 )
+                {
+                    m_counts[key] = 1;
+                    m_distances[first] = 1;
+                    return;
+                }
+
+                for( size_t i = first; i < first + m_counts[key]; ++i )
+                {
+                    m_distances[i] = 1 / m_distances[i];
+                }
+            }
+
+            VERTDB_BUCKET<unsigned char> m_status;
+            VERTDB_BUCKET<size_t> m_counts;
+            VERTDB_BUCKET<key_type> m_sources;
+            scalar_collection m_distances;
+            size_t m_source_count;
         };
 
-        typedef threaded_processor<processor_func, typename frontier_type::iterator, frontier_type> transfer_processor;
+        struct blend_func
+        {
+            void operator()( const key_type &key, staged_collection &collector )
+            {
+                size_t first = key * m_paths.m_source_count;
+
+                auto def = db_type::make_def();
+                m_results.blend_channels( m_paths.m_sources.data() + first, m_paths.m_distances.data() + first, m_paths.m_counts[key],
+                                          m_fill, def, m_resolver.m_weight_total, m_resolver.m_weight_clip, m_resolver.m_weight_normalize );
+                collector.emplace_back( key, VERTDB_MOVE( def ) );
+            }
 
-        int m_depth;
+            const self_type &m_resolver;
+            const path_state &m_paths;
+            const db_type &m_results;
+            item_flags m_fill;
+        };
+
+        typedef threaded_processor<blend_func, typename frontier_type::iterator, staged_collection> blend_processor;
+
+        size_t m_source_count;
+        scalar m_max_distance;
+        size_t m_weight_total;
+        vd::real m_weight_clip;
+        bool m_weight_normalize;
     };
 }
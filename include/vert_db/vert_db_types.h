@@ -27,6 +27,10 @@ namespace vd
     typedef VERTDB_PAIR<VERTDB_BONEID, VERTDB_BONEWEIGHT> bone_weight;
     typedef VERTDB_BUCKET<bone_weight> bone_weights;
 
+    typedef VERTDB_BONEINDEX bone_index;
+    typedef VERTDB_PAIR<bone_index, VERTDB_BONEWEIGHT> indexed_weight;
+    typedef VERTDB_BUCKET<indexed_weight> indexed_weights;
+
     typedef VERTDB_VERTID vert_id;
     typedef VERTDB_BUCKET<vert_id> vert_connects;
     typedef VERTDB_MAP<vert_id, vert_id> vert_directory;
@@ -35,6 +39,8 @@ namespace vd
 
     typedef VERTDB_MUTEX mutex_type;
     typedef VERTDB_LOCKGUARD<mutex_type> lock_type;
+    typedef VERTDB_UNIQUE_LOCK<mutex_type> unique_lock_type;
+    typedef VERTDB_CONDITION condition_type;
     typedef VERTDB_THREAD thread_type;
     typedef VERTDB_BUCKET<VERTDB_THREAD> thread_collection;
 }
@@ -106,10 +106,10 @@ namespace vd
         return vec;
     }
 
-    inline VERTDB_BUCKET<vec3i> flood( const vec3i &low, const vec3i &high )
+    // Calls func on every cell key in the inclusive box between low and high
+    template<typename F>
+    inline void for_each_cell( const vec3i &low, const vec3i &high, F func )
     {
-        VERTDB_BUCKET<vec3i> result;
-
         int_t low_x = ( low.x <= high.x ) ? low.x : high.x;
         int_t low_y = ( low.y <= high.y ) ? low.y : high.y;
         int_t low_z = ( low.z <= high.z ) ? low.z : high.z;
@@ -124,14 +124,58 @@ namespace vd
             {
                 for( int_t z = low_z; z <= high_z; ++z )
                 {
-                    result.emplace_back( vec3i{ x, y, z } );
+                    func( vec3i{ x, y, z } );
                 }
             }
         }
+    }
+
+    // Number of cells for_each_cell would visit
+    inline size_t cell_count( const vec3i &low, const vec3i &high )
+    {
+        size_t size_x = static_cast<size_t>( abs( high.x - low.x ) ) + 1;
+        size_t size_y = static_cast<size_t>( abs( high.y - low.y ) ) + 1;
+        size_t size_z = static_cast<size_t>( abs( high.z - low.z ) ) + 1;
+
+        return size_x * size_y * size_z;
+    }
+
+    inline VERTDB_BUCKET<vec3i> flood( const vec3i &low, const vec3i &high )
+    {
+        VERTDB_BUCKET<vec3i> result;
+        result.reserve( cell_count( low, high ) );
+
+        for_each_cell( low, high, [&]( const vec3i &cell )
+        {
+            result.emplace_back( cell );
+        } );
 
         return result;
     }
 
+    // Spreads the low 21 bits of value so two zero bits follow each one
+    inline unsigned long long morton_spread( unsigned long long value )
+    {
+        value &= 0x1fffff;
+        value = ( value | ( value << 32 ) ) & 0x1f00000000ffffULL;
+        value = ( value | ( value << 16 ) ) & 0x1f0000ff0000ffULL;
+        value = ( value | ( value << 8 ) ) & 0x100f00f00f00f00fULL;
+        value = ( value | ( value << 4 ) ) & 0x10c30c30c30c30c3ULL;
+        value = ( value | ( value << 2 ) ) & 0x1249249249249249ULL;
+        return value;
+    }
+
+    // Z-order curve index of a cell key, so nearby cells sort near each other
+    inline unsigned long long morton_code( const vec3i &cell )
+    {
+        const unsigned long long bias = 1 << 20;
+        unsigned long long x = morton_spread( static_cast<unsigned long long>( cell.x ) + bias );
+        unsigned long long y = morton_spread( static_cast<unsigned long long>( cell.y ) + bias );
+        unsigned long long z = morton_spread( static_cast<unsigned long long>( cell.z ) + bias );
+
+        return x | ( y << 1 ) | ( z << 2 );
+    }
+
     template<typename T>
     typename T::value_type deviation( const typename T::iterator &begin, const typename T::iterator &end )
     {
@@ -165,6 +209,13 @@ namespace vd
         return ( c_sqrt_inv_2pi / dev) * std::exp( -.5 * a * a );
     }
 
+    // gaussian_weight taking a squared distance, so callers can skip the sqrt
+    template<typename T>
+    T gaussian_weight_sq( T value_sq, T dev )
+    {
+        return ( c_sqrt_inv_2pi / dev) * std::exp( -.5 * value_sq / ( dev * dev ) );
+    }
+
     class sort_indicies_by_factor
     {
     public:
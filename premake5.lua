@@ -58,6 +58,10 @@ solution "vert_db"
             "./external/",
         }
 
+        defines {
+            "CATCH_CONFIG_ENABLE_BENCHMARKING",
+        }
+
         files {
             "./test/**.h",
             "./test/**.cpp",
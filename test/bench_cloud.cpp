@@ -0,0 +1,227 @@
+#include "catch2/catch.hpp"
+
+#include "fixtures.h"
+
+#include "vert_db/vert_db_kdtree.h"
+
+#include <sstream>
+
+// Benchmarks are hidden from the default run; use "[benchmark]" to select them.
+
+namespace
+{
+    // Writes a color to every key it is handed, optionally funnelled through one lock
+    struct ColorWriteFunc
+    {
+        void operator()( size_t key, SimpleTestDB::key_collection & )
+        {
+            auto def = db.make_def();
+            def.set_color( vd::vec3{ static_cast<vd::real>( key ), 0, 0 } );
+
+            if( single_lock )
+            {
+                vd::lock_type lock( *single_lock );
+                db.update( key, def );
+                return;
+            }
+
+            db.update_atomic( key, def );
+        }
+
+        SimpleTestDB &db;
+        vd::mutex_type *single_lock;
+    };
+}
+
+TEST_CASE( "point_cloud find serial vs parallel crossover", "[.][benchmark][point_cloud]" )
+{
+    const size_t point_count = 100000;
+
+    // Random points fill a 10 unit cube, so radius r touches roughly (2r+1)^3 unit cells
+    vd::point_cloud<size_t> cloud;
+    PointData points = add_random_points( cloud, point_count );
+    vd::vec3 probe{ 5, 5, 5 };
+
+    for( vd::real radius : { 0.25, 1.0, 2.0, 3.5, 5.0, 8.0 } )
+    {
+        size_t cells = cloud.grid_keys( probe, radius ).size();
+
+        std::stringstream serial_name;
+        serial_name << "serial   r=" << radius << " cells=" << cells;
+        cloud.set_parallel_threshold( VERTDB_NUMERIC_LIMITS<size_t>::max() );
+        BENCHMARK( serial_name.str() )
+        {
+            return cloud.find( probe, radius ).size();
+        };
+
+        std::stringstream parallel_name;
+        parallel_name << "parallel r=" << radius << " cells=" << cells;
+        cloud.set_parallel_threshold( 0 );
+        BENCHMARK( parallel_name.str() )
+        {
+            return cloud.find( probe, radius ).size();
+        };
+    }
+}
+
+TEST_CASE( "point_cloud vs kd_tree on clustered points", "[.][benchmark][kd_tree]" )
+{
+    // A dense cluster (face detail) inside a sparse volume (body)
+    const size_t dense_count = 50000;
+    const size_t sparse_count = 50000;
+
+    RandomReal<vd::real> dense( 4.9f, 5.1f );
+    RandomReal<vd::real> sparse( -50.0f, 50.0f );
+
+    std::vector<vd::vec3> points;
+    for( size_t i = 0; i < dense_count; ++i )
+    {
+        points.emplace_back( vd::vec3{ dense(), dense(), dense() } );
+    }
+    for( size_t i = 0; i < sparse_count; ++i )
+    {
+        points.emplace_back( vd::vec3{ sparse(), sparse(), sparse() } );
+    }
+
+    vd::point_cloud<size_t> cloud;
+    vd::kd_tree<size_t> tree;
+    for( size_t i = 0; i < points.size(); ++i )
+    {
+        cloud.insert( points[i], i );
+        tree.insert( points[i], i );
+    }
+    tree.build();
+
+    vd::vec3 dense_probe{ 5, 5, 5 };
+    vd::vec3 sparse_probe{ 30, -20, 10 };
+
+    BENCHMARK( "grid   radius dense" )
+    {
+        return cloud.find( dense_probe, .01f ).size();
+    };
+
+    BENCHMARK( "kdtree radius dense" )
+    {
+        return tree.find( dense_probe, .01f ).size();
+    };
+
+    BENCHMARK( "grid   radius sparse" )
+    {
+        return cloud.find( sparse_probe, 5 ).size();
+    };
+
+    BENCHMARK( "kdtree radius sparse" )
+    {
+        return tree.find( sparse_probe, 5 ).size();
+    };
+
+    BENCHMARK( "grid   nearest sparse" )
+    {
+        return cloud.find_k_nearest( sparse_probe, 8 ).size();
+    };
+
+    BENCHMARK( "kdtree nearest sparse" )
+    {
+        return tree.find_k_nearest( sparse_probe, 8 ).size();
+    };
+}
+
+TEST_CASE( "point_cloud insert vs bulk build", "[.][benchmark][point_cloud]" )
+{
+    const size_t point_count = 500000;
+
+    SimpleRandom r( 0.0f, 100.0f );
+    std::vector<vd::vec3> points;
+    std::vector<size_t> items;
+    for( size_t i = 0; i < point_count; ++i )
+    {
+        points.emplace_back( vd::vec3{ r(), r(), r() } );
+        items.emplace_back( i );
+    }
+
+    BENCHMARK( "insert" )
+    {
+        vd::point_cloud<size_t> cloud;
+        for( size_t i = 0; i < point_count; ++i )
+        {
+            cloud.insert( points[i], items[i] );
+        }
+        return cloud.count();
+    };
+
+    BENCHMARK( "build" )
+    {
+        vd::point_cloud<size_t> cloud;
+        cloud.build( points, items );
+        return cloud.count();
+    };
+}
+
+TEST_CASE( "vert_db update_atomic write throughput", "[.][benchmark][vert_db]" )
+{
+    SimpleTestDB db;
+    add_sphere( db, 10, 500, 500 );
+
+    SimpleTestDB::key_collection keys( db.begin(), db.end() );
+    SimpleTestDB::key_collection unused;
+    vd::mutex_type single_lock;
+
+    for( size_t thread_count : { 1, 2, 4, 8 } )
+    {
+        vd::thread_pool pool( thread_count );
+
+        std::stringstream single_name;
+        single_name << "single lock  threads=" << thread_count;
+        BENCHMARK( single_name.str() )
+        {
+            ColorWriteFunc func{ db, &single_lock };
+            vd::threaded_processor<ColorWriteFunc, SimpleTestDB::key_collection::iterator, SimpleTestDB::key_collection> processor( func, keys.begin(), keys.end(), unused, 0, pool );
+            processor.join();
+            return db.size();
+        };
+
+        std::stringstream sharded_name;
+        sharded_name << "sharded      threads=" << thread_count;
+        BENCHMARK( sharded_name.str() )
+        {
+            ColorWriteFunc func{ db, nullptr };
+            vd::threaded_processor<ColorWriteFunc, SimpleTestDB::key_collection::iterator, SimpleTestDB::key_collection> processor( func, keys.begin(), keys.end(), unused, 0, pool );
+            processor.join();
+            return db.size();
+        };
+    }
+}
+
+TEST_CASE( "vert_db separate vs fused sampling", "[.][benchmark][vert_db]" )
+{
+    const vd::real sphere_radius = 10;
+    const vd::real filter_radius = sphere_radius / 10;
+
+    SimpleTestDB db;
+    PointData points = add_sphere( db, sphere_radius, 300, 300 );
+
+    BENCHMARK( "sorted query + sample_color + find_weights" )
+    {
+        size_t found = 0;
+        for( size_t i = 0; i < points.size(); i += 97 )
+        {
+            auto verts = db.find_position_sorted( points[i], filter_radius );
+            auto color = db.sample_color( points[i], filter_radius );
+            auto weights = db.find_weights( points[i], filter_radius );
+            found += verts.size() + weights.size() + ( color.x > 0 );
+        }
+        return found;
+    };
+
+    BENCHMARK( "sample" )
+    {
+        size_t found = 0;
+        for( size_t i = 0; i < points.size(); i += 97 )
+        {
+            auto def = db.make_def();
+            db.sample( points[i], filter_radius, vd::k_item_id | vd::k_item_color | vd::k_item_weights, def );
+            found += def.weights.size() + ( def.color.x > 0 );
+        }
+        return found;
+    };
+}
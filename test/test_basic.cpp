@@ -29,4 +29,276 @@ TEST_CASE( "vert_db point queries", "[vert_db]" )
 
     // Should have been able to find an exact hit for every inserted point
     REQUIRE( found_hits == points.size() );
-}
\ No newline at end of file
+}
+
+TEST_CASE( "vert_db erase and compact", "[vert_db]" )
+{
+    SimpleTestDB db;
+    std::vector<vd::vec3> points = add_random_ring( db, 100 );
+
+    SimpleTestDB::key_collection doomed{ 3, 10, 11, 50 };
+    REQUIRE( db.erase_batch( doomed ) == doomed.size() );
+    REQUIRE( !db.erase( 3 ) );
+    REQUIRE( db.size() == points.size() - doomed.size() );
+    REQUIRE( db.erased_count() == doomed.size() );
+    REQUIRE( db.position_cloud().count() == db.size() );
+
+    for( auto key : doomed )
+    {
+        auto def = db.make_def();
+        REQUIRE( !db.gather( key, def ) );
+        REQUIRE( db.find_id( key ) == vd::c_invalid_vert_id );
+
+        auto found = db.find_position( points[key] );
+        REQUIRE( std::find( found.begin(), found.end(), key ) == found.end() );
+    }
+
+    // Connects to erased verts no longer resolve
+    auto neighbours = db.find_connects( 4 );
+    REQUIRE( std::find( neighbours.begin(), neighbours.end(), 3 ) == neighbours.end() );
+
+    auto remap = db.compact();
+    REQUIRE( remap.size() == points.size() );
+    REQUIRE( db.size() == points.size() - doomed.size() );
+    REQUIRE( db.erased_count() == 0 );
+
+    for( size_t old_key = 0; old_key < remap.size(); ++old_key )
+    {
+        bool erased = std::find( doomed.begin(), doomed.end(), old_key ) != doomed.end();
+        if( erased )
+        {
+            REQUIRE( remap[old_key] == vd::c_invalid_vert_id );
+            continue;
+        }
+
+        auto key = remap[old_key];
+        REQUIRE( key < db.size() );
+        REQUIRE( db.id( key ) == old_key );
+        REQUIRE( db.find_id( old_key ) == key );
+        REQUIRE( db.position( key ) == points[old_key] );
+        REQUIRE( db.find_nearest_position( points[old_key] ) == key );
+    }
+
+    // New inserts continue after the compacted range
+    auto def = db.make_def();
+    def.set_id( 1000 );
+    def.set_position( vd::vec3{ 50, 50, 50 } );
+    auto key = db.insert( def );
+    REQUIRE( key == db.size() - 1 );
+
+    // Erasing the key that owns a shared id leaves the other holder reachable
+    auto first = remap[20];
+    auto second = remap[30];
+    for( auto shared : { first, second } )
+    {
+        auto shared_def = db.make_def();
+        shared_def.set_id( 2000 );
+        db.update( shared, shared_def );
+    }
+
+    REQUIRE( db.find_id( 2000 ) == second );
+    REQUIRE( db.erase( second ) );
+    REQUIRE( db.find_id( 2000 ) == first );
+}
+
+TEST_CASE( "vert_db batch inserts", "[vert_db]" )
+{
+    SimpleTestDB single;
+    add_sphere( single, 10, 30, 30 );
+
+    std::vector<SimpleTestDB::def_type> defs;
+    for( size_t key = 0; key < single.size(); ++key )
+    {
+        auto def = single.make_def();
+        single.gather( key, def );
+        defs.emplace_back( def );
+    }
+
+    SimpleTestDB batched;
+    REQUIRE( batched.insert_batch( defs.begin(), defs.end() ) == 0 );
+    REQUIRE( batched == single );
+    REQUIRE( batched.position_cloud().count() == single.position_cloud().count() );
+    REQUIRE( batched.color_cloud().count() == single.color_cloud().count() );
+
+    for( size_t key = 0; key < defs.size(); key += 7 )
+    {
+        REQUIRE( batched.find_id( defs[key].id ) == key );
+        REQUIRE( batched.find_nearest_position( defs[key].position ) == single.find_nearest_position( defs[key].position ) );
+        REQUIRE( batched.find_connects( key, 2 ) == single.find_connects( key, 2 ) );
+    }
+
+    // Parallel arrays append after what is already there
+    SimpleTestDB::point_collection positions{ { 100, 0, 0 }, { 101, 0, 0 } };
+    SimpleTestDB::point_collection normals{ { 1, 0, 0 }, { 0, 1, 0 } };
+    std::vector<vd::bone_weights> weights{ { { "joint_0", 1.0f } }, { { "extra", 1.0f } } };
+    auto first = batched.insert_batch( positions, normals, weights );
+    REQUIRE( first == defs.size() );
+    REQUIRE( batched.size() == defs.size() + 2 );
+    REQUIRE( batched.find_nearest_position( positions[1] ) == first + 1 );
+    REQUIRE( batched.normal( first + 1 ) == normals[1] );
+    REQUIRE( batched.weights( first + 1 ) == weights[1] );
+
+    // Small batches join a built cloud, large ones release it for one bulk rebuild on the next query
+    REQUIRE( vd::flag_is_set( batched.built_indices(), vd::k_item_position ) );
+
+    SimpleTestDB::point_collection bulk;
+    for( size_t i = 0; i < batched.size(); ++i )
+    {
+        bulk.emplace_back( vd::vec3{ 200 + static_cast<vd::real>( i ), 0, 0 } );
+    }
+
+    auto bulk_first = batched.insert_batch( bulk );
+    REQUIRE( !vd::flag_is_set( batched.built_indices(), vd::k_item_position ) );
+    REQUIRE( batched.find_nearest_position( bulk[10] ) == bulk_first + 10 );
+    REQUIRE( batched.find_nearest_position( positions[1] ) == first + 1 );
+    REQUIRE( batched.position_cloud().count() == batched.size() );
+}
+
+TEST_CASE( "vert_db builds indices on first use", "[vert_db]" )
+{
+    SimpleTestDB db;
+    std::vector<vd::vec3> points = add_random_ring( db, 100 );
+    REQUIRE( db.built_indices() == vd::k_item_none );
+
+    // Position queries only build the position cloud
+    REQUIRE( db.find_nearest_position( points[5] ) == 5 );
+    REQUIRE( db.built_indices() == vd::k_item_position );
+
+    // Built indices follow later edits
+    auto def = db.make_def();
+    def.set_position( vd::vec3{ 50, 50, 50 } );
+    db.update( 5, def );
+    REQUIRE( db.find_nearest_position( vd::vec3{ 50, 50, 50 } ) == 5 );
+    REQUIRE( db.position_cloud().count() == points.size() );
+
+    // Unbuilt ones catch up in bulk when first queried
+    def.set_id( 500 );
+    db.update( 6, def );
+    REQUIRE( db.find_id( 500 ) == 6 );
+    REQUIRE( db.find_id( 6 ) == vd::c_invalid_vert_id );
+    REQUIRE( vd::flag_is_set( db.built_indices(), vd::k_item_id ) );
+
+    db.build_indices();
+    REQUIRE( db.built_indices() == ( vd::k_item_id | vd::k_item_position | vd::k_item_uvw | vd::k_item_color | vd::k_item_connects ) );
+}
+
+namespace
+{
+    struct ShardedUpdateFunc
+    {
+        void operator()( size_t key, SimpleTestDB::key_collection & )
+        {
+            // Every third vert introduces a new bone, which has to take the exclusive path
+            vd::bone_weights weights;
+            weights.emplace_back( ( key % 3 ) ? "joint_0" : "extra_" + std::to_string( key ), 1.0f );
+
+            auto def = db.make_def();
+            def.set_position( db.position( key ) + offset );
+            def.set_color( vd::vec3{ static_cast<vd::real>( key ), 0, 0 } );
+            def.set_weights( weights );
+            db.update_atomic( key, def );
+        }
+
+        SimpleTestDB &db;
+        vd::vec3 offset;
+    };
+}
+
+TEST_CASE( "vert_db directory resolves shared ids like a rebuild", "[vert_db]" )
+{
+    SimpleTestDB db;
+    add_random_ring( db, 20 );
+    REQUIRE( db.find_id( 5 ) == 5 );
+
+    auto set_id = [&]( SimpleTestDB::key_type key, vd::vert_id id )
+    {
+        auto def = db.make_def();
+        def.set_id( id );
+        db.update( key, def );
+    };
+
+    // Keys sharing an id resolve to the highest key, whichever order they were set in
+    set_id( 12, 100 );
+    set_id( 7, 100 );
+    REQUIRE( db.find_id( 100 ) == 12 );
+
+    // Moving the owner to a new id leaves the other holder reachable
+    set_id( 12, 200 );
+    REQUIRE( db.find_id( 100 ) == 7 );
+    REQUIRE( db.find_id( 200 ) == 12 );
+    REQUIRE( db.find_id( 12 ) == vd::c_invalid_vert_id );
+
+    // Once nothing is shared, retiring an id just drops its entry
+    set_id( 7, 300 );
+    REQUIRE( db.find_id( 100 ) == vd::c_invalid_vert_id );
+    REQUIRE( db.find_id( 300 ) == 7 );
+}
+
+TEST_CASE( "vert_db sharded atomic updates", "[vert_db]" )
+{
+    // No colors yet, so the first color write has to make room in the channel
+    SimpleTestDB db;
+    PointData points = add_sphere( db, 10, 40, 40, vd::k_item_id | vd::k_item_position | vd::k_item_weights | vd::k_item_connects );
+    db.build_indices( vd::k_item_position );
+
+    vd::thread_pool pool( 3 );
+    SimpleTestDB::key_collection keys( db.begin(), db.end() );
+    SimpleTestDB::key_collection unused;
+    ShardedUpdateFunc func{ db, vd::vec3{ 100, 0, 0 } };
+    vd::threaded_processor<ShardedUpdateFunc, SimpleTestDB::key_collection::iterator, SimpleTestDB::key_collection> processor( func, keys.begin(), keys.end(), unused, 0, pool );
+    processor.join();
+
+    for( const auto &key : keys )
+    {
+        REQUIRE( db.color( key ) == vd::vec3{ static_cast<vd::real>( key ), 0, 0 } );
+        REQUIRE( db.position( key ) == points[key] + func.offset );
+
+        auto weights = db.weights( key );
+        REQUIRE( weights.size() == 1 );
+        REQUIRE( weights[0].first == ( ( key % 3 ) ? "joint_0" : "extra_" + std::to_string( key ) ) );
+
+        // The built position cloud followed every move
+        auto found = db.find_position( points[key] + func.offset );
+        REQUIRE( std::find( found.begin(), found.end(), key ) != found.end() );
+        found = db.find_position( points[key] );
+        REQUIRE( std::find( found.begin(), found.end(), key ) == found.end() );
+    }
+}
+
+TEST_CASE( "vert_db batched updates", "[vert_db]" )
+{
+    SimpleTestDB batched;
+    SimpleTestDB single;
+    PointData points = add_sphere( batched, 10, 30, 30 );
+    add_sphere( single, 10, 30, 30 );
+    batched.build_indices();
+    single.build_indices();
+
+    // A small batch moves points in the built clouds, a large one drops them for a bulk rebuild
+    for( size_t stride : { 50, 2 } )
+    {
+        SimpleTestDB::staged_collection edits;
+        for( size_t key = 0; key < points.size(); key += stride )
+        {
+            auto def = batched.make_def();
+            def.set_position( points[key] * static_cast<vd::real>( stride ) );
+            def.set_color( vd::vec3{ 0, static_cast<vd::real>( key ), 0 } );
+            edits.emplace_back( key, def );
+            single.update( key, def );
+        }
+
+        batched.update_batch( edits.begin(), edits.end() );
+        REQUIRE( vd::flag_is_set( batched.built_indices(), vd::k_item_position ) == ( stride == 50 ) );
+
+        for( const auto &edit : edits )
+        {
+            REQUIRE( batched.position( edit.first ) == single.position( edit.first ) );
+            REQUIRE( batched.color( edit.first ) == single.color( edit.first ) );
+
+            auto found = batched.find_position( edit.second.position );
+            REQUIRE( std::find( found.begin(), found.end(), edit.first ) != found.end() );
+        }
+    }
+
+    REQUIRE( batched == single );
+}
@@ -0,0 +1,57 @@
+#include "catch2/catch.hpp"
+
+#include "fixtures.h"
+
+TEST_CASE( "dense_channel behaves like sparse storage", "[dense_channel]" )
+{
+    vd::dense_channel<size_t, vd::vec3> channel;
+    REQUIRE( channel.empty() );
+
+    // Writing a far key should leave everything below it absent
+    channel[70] = vd::vec3{ 1, 2, 3 };
+    REQUIRE( channel.size() == 1 );
+    REQUIRE( channel.contains( 70 ) );
+    REQUIRE( !channel.contains( 3 ) );
+    REQUIRE( channel.find( 3 ) == channel.end() );
+
+    auto found = channel.find( 70 );
+    REQUIRE( found != channel.end() );
+    REQUIRE( found->first == 70 );
+    REQUIRE( found->second == vd::vec3{ 1, 2, 3 } );
+
+    // Rewriting a present key should not change the count
+    channel[70] = vd::vec3{ 4, 5, 6 };
+    channel[2] = vd::vec3{ 7, 8, 9 };
+    REQUIRE( channel.size() == 2 );
+
+    // Iteration only visits present keys, in key order
+    std::vector<size_t> visited;
+    for( const auto &item : channel )
+    {
+        visited.emplace_back( item.first );
+    }
+    REQUIRE( visited == std::vector<size_t>{ 2, 70 } );
+
+    REQUIRE( channel.erase( 2 ) == 1 );
+    REQUIRE( channel.erase( 2 ) == 0 );
+    REQUIRE( !channel.contains( 2 ) );
+    REQUIRE( channel.size() == 1 );
+}
+
+TEST_CASE( "vert_db channels report missing data", "[vert_db]" )
+{
+    SimpleTestDB db;
+    add_sphere( db, 10, 10, 10, vd::flag_without( vd::k_item_all, vd::k_item_color ) );
+
+    auto def = db.make_def();
+    REQUIRE( db.gather( 0, def ) );
+    REQUIRE( def.has_position() );
+    REQUIRE( !def.has_color() );
+
+    // Unset channels still answer with default values
+    REQUIRE( db.color( 0 ) == vd::vec3{} );
+
+    SimpleTestDB copy;
+    add_sphere( copy, 10, 10, 10, vd::flag_without( vd::k_item_all, vd::k_item_color ) );
+    REQUIRE( db == copy );
+}
@@ -44,3 +44,463 @@ TEST_CASE( "point_cloud resizing", "[point_cloud]" )
 
     REQUIRE( found_hits == points.size() );
 }
+
+TEST_CASE( "point_cloud nearest queries", "[point_cloud]" )
+{
+    size_t count = 500;
+    size_t k = 8;
+
+    vd::point_cloud<size_t> cloud( .5 );
+    std::vector<vd::vec3> points = add_random_points( cloud, count );
+
+    RandomReal<vd::real> r( -2.0f, 12.0f );
+    for( size_t probe_index = 0; probe_index < 50; ++probe_index )
+    {
+        vd::vec3 probe{ r(), r(), r() };
+
+        // Brute force distances for comparison
+        std::vector<vd::real> expected;
+        for( const auto &point : points )
+        {
+            vd::vec3 between = probe - point;
+            expected.emplace_back( vd::dot( between, between ) );
+        }
+        std::sort( expected.begin(), expected.end() );
+
+        auto found = cloud.find_k_nearest( probe, k );
+        REQUIRE( found.size() == k );
+
+        for( size_t i = 0; i < k; ++i )
+        {
+            vd::vec3 between = probe - points[found[i]];
+            REQUIRE( vd::near_equal( vd::dot( between, between ), expected[i], cloud.epsilon() ) );
+        }
+
+        size_t nearest = 0;
+        REQUIRE( cloud.find_nearest( probe, nearest ) );
+        REQUIRE( nearest == found.front() );
+    }
+
+    // Radius limits should be respected
+    size_t missed = 0;
+    REQUIRE( !cloud.find_nearest( vd::vec3{ 100, 100, 100 }, missed, 1 ) );
+}
+
+TEST_CASE( "vert_db nearest position queries", "[vert_db]" )
+{
+    SimpleTestDB db;
+    std::vector<vd::vec3> points = add_random_ring( db, 100 );
+
+    // Every inserted point should be its own nearest neighbour
+    for( size_t i = 0; i < points.size(); ++i )
+    {
+        REQUIRE( db.find_nearest_position( points[i] ) == i );
+    }
+
+    vd::vec3 far_point{ 1000, 1000, 1000 };
+    REQUIRE( db.find_nearest_position( far_point, 1 ) == vd::c_invalid_vert_id );
+    REQUIRE( db.find_nearest_position( far_point ) != vd::c_invalid_vert_id );
+
+    auto nearest = db.find_k_nearest_position( points[0], 3 );
+    REQUIRE( nearest.size() == 3 );
+    REQUIRE( nearest.front() == 0 );
+}
+
+TEST_CASE( "point_cloud buffered and visitor queries", "[point_cloud]" )
+{
+    vd::point_cloud<size_t> cloud;
+    std::vector<vd::vec3> points = add_random_points( cloud, 200 );
+    vd::real radius = 1.5f;
+
+    vd::point_cloud<size_t>::results_type buffer;
+    for( const auto &point : points )
+    {
+        auto expected = cloud.find( point, radius );
+
+        // Buffered queries replace the previous contents
+        cloud.find( point, radius, buffer );
+        REQUIRE( buffer == expected );
+
+        size_t visited = 0;
+        cloud.visit( point, radius, [&]( size_t item, vd::real dist_sq )
+        {
+            REQUIRE( dist_sq <= radius * radius );
+            REQUIRE( item == expected[visited] );
+            ++visited;
+        } );
+        REQUIRE( visited == expected.size() );
+    }
+}
+
+TEST_CASE( "vert_db sorted position queries", "[vert_db]" )
+{
+    SimpleTestDB db;
+    std::vector<vd::vec3> points = add_random_ring( db, 100 );
+
+    auto sorted = db.find_position_sorted( points[0], 3 );
+    auto unsorted = db.find_position( points[0], 3 );
+    REQUIRE( sorted.size() == unsorted.size() );
+    REQUIRE( sorted.front() == 0 );
+
+    for( size_t i = 1; i < sorted.size(); ++i )
+    {
+        REQUIRE( db.distance_to( points[0], sorted[i - 1] ) <= db.distance_to( points[0], sorted[i] ) );
+    }
+}
+
+TEST_CASE( "point_cloud batch queries", "[point_cloud]" )
+{
+    vd::point_cloud<size_t> cloud;
+    std::vector<vd::vec3> points = add_random_points( cloud, 1000 );
+
+    RandomReal<vd::real> r( -1.0f, 11.0f );
+    std::vector<vd::vec3> probes;
+    for( size_t i = 0; i < 600; ++i )
+    {
+        probes.emplace_back( vd::vec3{ r(), r(), r() } );
+    }
+
+    vd::real radius = 1.0f;
+    auto batch = cloud.find_batch( probes, radius );
+    REQUIRE( batch.size() == probes.size() );
+
+    // Every query should match its own single query, in the original order
+    for( size_t i = 0; i < probes.size(); ++i )
+    {
+        auto expected = cloud.find( probes[i], radius );
+        std::vector<size_t> found( batch.begin( i ), batch.end( i ) );
+
+        std::sort( expected.begin(), expected.end() );
+        std::sort( found.begin(), found.end() );
+        REQUIRE( found == expected );
+    }
+
+    auto empty = cloud.find_batch( {}, radius );
+    REQUIRE( empty.size() == 0 );
+}
+
+TEST_CASE( "point_cloud occupancy statistics", "[point_cloud]" )
+{
+    vd::point_cloud<size_t> cloud;
+    cloud.insert( vd::vec3{ .1f, .1f, .1f }, 0 );
+    cloud.insert( vd::vec3{ .2f, .2f, .2f }, 1 );
+    cloud.insert( vd::vec3{ .3f, .3f, .3f }, 2 );
+    cloud.insert( vd::vec3{ 5.5f, .5f, .5f }, 3 );
+
+    auto stats = cloud.stats();
+    REQUIRE( stats.bucket_count == 2 );
+    REQUIRE( stats.point_count == 4 );
+    REQUIRE( stats.min_points == 1 );
+    REQUIRE( stats.max_points == 3 );
+    REQUIRE( stats.mean_points == Approx( 2 ) );
+
+    // One bucket with 1 point, one with 2-3 points
+    REQUIRE( stats.histogram == std::vector<size_t>{ 1, 1 } );
+}
+
+TEST_CASE( "point_cloud picks a bucket width from density", "[point_cloud]" )
+{
+    // Centimetre scale sphere collapses into a single unit bucket
+    SimpleTestDB db;
+    add_sphere( db, .05f, 40, 40 );
+
+    auto before = db.position_cloud().stats();
+    REQUIRE( before.bucket_count <= 8 );
+
+    db.auto_rebucket();
+
+    auto after = db.position_cloud().stats();
+    REQUIRE( after.point_count == before.point_count );
+    REQUIRE( after.mean_points > VERTDB_CLOUD_TARGET_OCCUPANCY / 4.0 );
+    REQUIRE( after.mean_points < VERTDB_CLOUD_TARGET_OCCUPANCY * 4.0 );
+
+    // Queries must still find every point
+    for( const auto &key : db )
+    {
+        REQUIRE( db.find_nearest_position( db.position( key ), .001f ) != vd::c_invalid_vert_id );
+    }
+}
+
+TEST_CASE( "vert_db re-tunes clouds as it grows", "[vert_db]" )
+{
+    SimpleTestDB db;
+    db.set_auto_rebucket( true );
+    add_sphere( db, .05f, 40, 40 );
+
+    auto stats = db.position_cloud().stats();
+    REQUIRE( stats.bucket_width < 1 );
+}
+
+TEST_CASE( "point_cloud frozen layout", "[point_cloud]" )
+{
+    vd::point_cloud<size_t> cloud( .5f );
+    std::vector<vd::vec3> points = add_random_points( cloud, 1000 );
+
+    RandomReal<vd::real> r( -1.0f, 11.0f );
+    std::vector<vd::vec3> probes;
+    for( size_t i = 0; i < 50; ++i )
+    {
+        probes.emplace_back( vd::vec3{ r(), r(), r() } );
+    }
+
+    std::vector<std::vector<size_t>> expected;
+    std::vector<std::vector<size_t>> expected_nearest;
+    for( const auto &probe : probes )
+    {
+        auto found = cloud.find( probe, 1.0f );
+        std::sort( found.begin(), found.end() );
+        expected.emplace_back( found );
+        expected_nearest.emplace_back( cloud.find_k_nearest( probe, 4 ) );
+    }
+
+    auto stats_before = cloud.stats();
+    cloud.freeze();
+    REQUIRE( cloud.frozen() );
+    REQUIRE( cloud.size() == stats_before.bucket_count );
+    REQUIRE( cloud.stats().histogram == stats_before.histogram );
+
+    for( size_t i = 0; i < probes.size(); ++i )
+    {
+        auto found = cloud.find( probes[i], 1.0f );
+        std::sort( found.begin(), found.end() );
+        REQUIRE( found == expected[i] );
+        REQUIRE( cloud.find_k_nearest( probes[i], 4 ) == expected_nearest[i] );
+    }
+
+    // Rebucketing keeps the frozen layout
+    cloud.rebucket( .25f );
+    REQUIRE( cloud.frozen() );
+    REQUIRE( !cloud.find( points[0] ).empty() );
+
+    // Inserting returns to the mutable layout
+    cloud.insert( vd::vec3{ 20, 20, 20 }, points.size() );
+    REQUIRE( !cloud.frozen() );
+    REQUIRE( cloud.count() == points.size() + 1 );
+    REQUIRE( cloud.find( vd::vec3{ 20, 20, 20 } ).size() == 1 );
+    REQUIRE( !cloud.find( points[0] ).empty() );
+}
+
+template<typename S>
+void check_radius_kernel()
+{
+    RandomReal<S> r( -2.0f, 2.0f );
+    for( size_t count = 0; count < 67; ++count )
+    {
+        std::vector<S> xs, ys, zs;
+        for( size_t i = 0; i < count; ++i )
+        {
+            xs.emplace_back( r() );
+            ys.emplace_back( r() );
+            zs.emplace_back( r() );
+        }
+
+        std::vector<size_t> hits( count + 1 ), expected_hits( count + 1 );
+        std::vector<S> dists( count + 1 ), expected_dists( count + 1 );
+        S qx = r(), qy = r(), qz = r();
+
+        size_t found = vd::radius_kernel<S>::filter( xs.data(), ys.data(), zs.data(), count, qx, qy, qz, 2, hits.data(), dists.data() );
+        size_t expected = vd::radius_kernel<S>::filter_scalar( xs.data(), ys.data(), zs.data(), 0, count, qx, qy, qz, 2, expected_hits.data(), expected_dists.data(), 0 );
+
+        REQUIRE( found == expected );
+        for( size_t i = 0; i < found; ++i )
+        {
+            REQUIRE( hits[i] == expected_hits[i] );
+            REQUIRE( dists[i] == Approx( expected_dists[i] ) );
+        }
+    }
+}
+
+TEST_CASE( "radius kernel matches the scalar path", "[point_cloud]" )
+{
+    check_radius_kernel<double>();
+    check_radius_kernel<float>();
+}
+
+TEST_CASE( "vert_db batch distances", "[vert_db]" )
+{
+    SimpleTestDB db;
+    add_random_ring( db, 100 );
+
+    SimpleTestDB::key_collection keys( db.begin(), db.end() );
+    vd::vec3 probe{ 5, 5, 5 };
+
+    SimpleTestDB::scalar_collection dist_sq, dist;
+    db.distances_sq_to( probe, keys, dist_sq );
+    db.distances_to( probe, keys, dist );
+
+    REQUIRE( dist.size() == keys.size() );
+    for( size_t i = 0; i < keys.size(); ++i )
+    {
+        REQUIRE( dist[i] == Approx( db.distance_to( probe, keys[i] ) ) );
+        REQUIRE( dist_sq[i] == Approx( dist[i] * dist[i] ) );
+    }
+
+    // Radius query distances agree with the per key lookups
+    SimpleTestDB::results_type found;
+    db.find_position_distances( probe, 3.0f, found, dist_sq );
+    REQUIRE( !found.empty() );
+    REQUIRE( found.size() == dist_sq.size() );
+    for( size_t i = 0; i < found.size(); ++i )
+    {
+        REQUIRE( sqrt( dist_sq[i] ) == Approx( db.distance_to( probe, found[i] ) ) );
+    }
+}
+
+TEST_CASE( "point_cloud erase and move", "[point_cloud]" )
+{
+    vd::point_cloud<size_t> cloud( .5f );
+    std::vector<vd::vec3> points = add_random_points( cloud, 200 );
+
+    REQUIRE( cloud.erase( points[0], 0 ) );
+    REQUIRE( !cloud.erase( points[0], 0 ) );
+    REQUIRE( cloud.count() == points.size() - 1 );
+
+    auto found = cloud.find( points[0] );
+    REQUIRE( std::find( found.begin(), found.end(), 0 ) == found.end() );
+
+    // Within the same cell and across cells
+    vd::vec3 nudged = points[1] + vd::vec3{ .001f, 0, 0 };
+    cloud.move( points[1], nudged, 1 );
+    vd::vec3 far_point{ 50, 50, 50 };
+    cloud.move( points[2], far_point, 2 );
+    REQUIRE( cloud.count() == points.size() - 1 );
+
+    REQUIRE( cloud.find( far_point ) == std::vector<size_t>{ 2 } );
+    found = cloud.find( points[2] );
+    REQUIRE( std::find( found.begin(), found.end(), 2 ) == found.end() );
+
+    size_t nearest = 0;
+    REQUIRE( cloud.find_nearest( nudged, nearest ) );
+    REQUIRE( nearest == 1 );
+
+    // Frozen clouds thaw to edit
+    cloud.freeze();
+    REQUIRE( cloud.erase( far_point, 2 ) );
+    REQUIRE( !cloud.frozen() );
+    REQUIRE( cloud.find( far_point ).empty() );
+    REQUIRE( cloud.stats().point_count == points.size() - 2 );
+}
+
+TEST_CASE( "point_cloud erase and move in a crowded cell", "[point_cloud]" )
+{
+    // One cell holds every point, so erase and move rely on the slot index rather than a scan
+    const size_t point_count = 500;
+    vd::point_cloud<size_t> built( 100 );
+    vd::point_cloud<size_t> inserted( 100 );
+
+    PointData points;
+    SimpleRandom r;
+    std::vector<size_t> items;
+    for( size_t i = 0; i < point_count; ++i )
+    {
+        points.emplace_back( vd::vec3{ r(), r(), r() } );
+        items.emplace_back( i );
+        inserted.insert( points[i], i );
+    }
+
+    built.build( points, items );
+
+    for( auto *cloud : { &built, &inserted } )
+    {
+        REQUIRE( cloud->size() == 1 );
+
+        // Erasing from the front keeps swapping the back item into freed slots
+        for( size_t i = 0; i < point_count; i += 2 )
+        {
+            REQUIRE( cloud->erase( points[i], i ) );
+        }
+
+        REQUIRE( !cloud->erase( points[0], 0 ) );
+
+        for( size_t i = 1; i < point_count; i += 4 )
+        {
+            cloud->move( points[i], points[i] + vd::vec3{ .5f, 0, 0 }, i );
+        }
+
+        REQUIRE( cloud->count() == point_count / 2 );
+
+        auto found = cloud->find( vd::vec3{ 5, 5, 5 }, 20 );
+        std::sort( found.begin(), found.end() );
+        REQUIRE( found.size() == point_count / 2 );
+        for( size_t i = 0; i < found.size(); ++i )
+        {
+            REQUIRE( found[i] == ( i * 2 ) + 1 );
+        }
+
+        size_t nearest = 0;
+        REQUIRE( cloud->find_nearest( points[5] + vd::vec3{ .5f, 0, 0 }, nearest ) );
+        REQUIRE( nearest == 5 );
+
+        // A duplicate item is still found once its indexed copy is gone
+        cloud->insert( points[3], 3 );
+        REQUIRE( cloud->erase( points[3], 3 ) );
+        REQUIRE( cloud->erase( points[3], 3 ) );
+        REQUIRE( !cloud->erase( points[3], 3 ) );
+        REQUIRE( cloud->count() == ( point_count / 2 ) - 1 );
+    }
+}
+
+TEST_CASE( "vert_db updates move verts in the clouds", "[vert_db]" )
+{
+    SimpleTestDB db;
+    std::vector<vd::vec3> points = add_random_ring( db, 100 );
+
+    vd::vec3 moved{ 50, 50, 50 };
+    for( size_t step = 0; step < 3; ++step )
+    {
+        auto def = db.make_def();
+        def.set_position( moved + vd::vec3{ vd::real( step ), 0, 0 } );
+        db.update( 0, def );
+    }
+
+    REQUIRE( db.position_cloud().count() == points.size() );
+    REQUIRE( db.find_position( points[0] ).empty() );
+    REQUIRE( db.find_position( moved ).empty() );
+    REQUIRE( db.find_position( moved + vd::vec3{ 2, 0, 0 } ) == SimpleTestDB::results_type{ 0 } );
+
+    // Changing an id drops the old directory entry
+    auto def = db.make_def();
+    def.set_id( 1000 );
+    db.update( 0, def );
+    REQUIRE( db.find_id( 1000 ) == 0 );
+    REQUIRE( db.find_id( 0 ) == vd::c_invalid_vert_id );
+}
+
+TEST_CASE( "point_cloud bulk build", "[point_cloud]" )
+{
+    // Enough points for several key and sort chunks, plus an odd one out when merging
+    const size_t count = VERTDB_CLOUD_BUILD_CHUNK * 4 + 100;
+
+    vd::point_cloud<size_t> inserted( .5f );
+    std::vector<vd::vec3> points = add_random_points( inserted, count );
+    std::vector<size_t> items( count );
+    std::iota( items.begin(), items.end(), 0 );
+
+    vd::point_cloud<size_t> built( .5f );
+    built.build( points, items );
+    REQUIRE( built.count() == count );
+    REQUIRE( built.size() == inserted.size() );
+    REQUIRE( built.stats().histogram == inserted.stats().histogram );
+
+    RandomReal<vd::real> r( -1.0f, 11.0f );
+    for( size_t i = 0; i < 50; ++i )
+    {
+        vd::vec3 probe{ r(), r(), r() };
+        auto expected = inserted.find( probe, 1.0f );
+        auto found = built.find( probe, 1.0f );
+        std::sort( expected.begin(), expected.end() );
+        std::sort( found.begin(), found.end() );
+        REQUIRE( found == expected );
+        REQUIRE( built.find_k_nearest( probe, 3 ) == inserted.find_k_nearest( probe, 3 ) );
+    }
+
+    // Rebucketing goes through the same build
+    built.rebucket( .25f );
+    inserted.rebucket( .25f );
+    REQUIRE( built.count() == count );
+    REQUIRE( built.stats().histogram == inserted.stats().histogram );
+
+    built.build( std::vector<vd::vec3>(), std::vector<size_t>() );
+    REQUIRE( built.count() == 0 );
+    REQUIRE( built.find( points[0] ).empty() );
+}
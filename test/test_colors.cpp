@@ -56,16 +56,19 @@ TEST_CASE( "vert_db color transfer", "[vert_db]" )
     vd::item_flags src_flags = vd::k_item_all;
     vd::item_flags dest_flags = flag_without(vd::k_item_all, vd::k_item_color);
 
+    // Only carry color across so destination verts stay where they are
+    vd::item_flags transfer_flags = vd::k_item_color;
+
     // Set up blank sphere as target
     SimpleTestDB dest_data;
     add_sphere( dest_data, sphere_radius, dest_sphere_dim, dest_sphere_dim, dest_flags );
 
     // Transfer DB has one fully specified sphere
     vd::transfer_db<size_t> source;
-    source.add_resolver< vd::transfer_resolver_matched<size_t> >( src_flags );
-    source.add_resolver< vd::transfer_resolver_position<size_t> >( src_flags );
-    source.add_resolver< vd::transfer_resolver_gaussian<size_t> >( src_flags, filter_radius );
-    source.add_resolver< vd::transfer_flood_fill<size_t> >( src_flags );
+    source.add_resolver< vd::transfer_resolver_matched<size_t> >( transfer_flags );
+    source.add_resolver< vd::transfer_resolver_position<size_t> >( transfer_flags );
+    source.add_resolver< vd::transfer_resolver_gaussian<size_t> >( transfer_flags, filter_radius );
+    source.add_resolver< vd::transfer_flood_fill<size_t> >( transfer_flags );
 
     add_sphere( source.vert_db(), sphere_radius, src_sphere_dim, src_sphere_dim, src_flags );
 
@@ -107,3 +110,38 @@ TEST_CASE( "vert_db color transfer", "[vert_db]" )
     // Averaged offset query should probably not match the Z pole
     REQUIRE( !vd::near_equal(dest_sampled, dest_color, color_tolerance) );
 }
+
+TEST_CASE( "vert_db fused channel sampling", "[vert_db]" )
+{
+    const vd::real sphere_radius = 10;
+    const vd::real filter_radius = sphere_radius / 4;
+
+    SimpleTestDB db;
+    PointData points = add_sphere( db, sphere_radius, 30, 30 );
+    for( const auto &key : db )
+    {
+        auto def = db.make_def();
+        def.set_normal( points[key] * ( 1 / sphere_radius ) );
+        db.update( key, def );
+    }
+
+    vd::item_flags flags = vd::k_item_id | vd::k_item_normal | vd::k_item_color | vd::k_item_weights;
+    for( size_t i = 0; i < points.size(); i += 7 )
+    {
+        vd::vec3 probe = points[i] * static_cast<vd::real>( 1.01 );
+
+        // One query matches the separate per-channel samplers
+        auto def = db.make_def();
+        REQUIRE( db.sample( probe, filter_radius, flags, def ) );
+        REQUIRE( vd::near_equal( def.color, db.sample_color( probe, filter_radius ), static_cast<vd::real>( 1e-5 ) ) );
+        REQUIRE( def.weights == db.find_weights( probe, filter_radius ) );
+        REQUIRE( def.id == db.id( db.find_nearest_position( probe, filter_radius ) ) );
+
+        vd::real length_sq = vd::dot( def.normal, def.normal );
+        REQUIRE( std::abs( length_sq - 1 ) < 1e-4 );
+        REQUIRE( !def.has_position() );
+    }
+
+    auto missed = db.make_def();
+    REQUIRE( !db.sample( vd::vec3{ 0, 0, sphere_radius * 100 }, filter_radius, flags, missed ) );
+}
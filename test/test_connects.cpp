@@ -24,3 +24,81 @@ TEST_CASE( "vert_db connectivity queries", "[vert_db]" )
     auto expanded_connects = db.find_connects( shallow_connects, 1, true );
     REQUIRE( expanded_connects == inclusive_connects );
 }
+
+TEST_CASE( "vert_db compiled adjacency", "[vert_db]" )
+{
+    SimpleTestDB db;
+    add_random_ring( db, 25 );
+
+    // Rows hold internal keys for each connected id
+    const auto &graph = db.adjacency();
+    REQUIRE( graph.size() == db.size() );
+    REQUIRE( graph.edge_count() == 50 );
+    for( const auto &key : db )
+    {
+        auto row = graph.neighbours( key );
+        auto connects = db.connects( key );
+        REQUIRE( row.size() == connects.size() );
+
+        size_t i = 0;
+        for( const auto &neighbour : row )
+        {
+            REQUIRE( neighbour == db.find_id( connects[i++] ) );
+        }
+    }
+
+    // Ids that differ from keys still resolve through the directory
+    shuffle_ids( db );
+    for( const auto &key : db )
+    {
+        for( const auto &neighbour : db.adjacency().neighbours( key ) )
+        {
+            auto connects = db.connects( key );
+            REQUIRE( std::find( connects.begin(), connects.end(), db.id( neighbour ) ) != connects.end() );
+        }
+    }
+
+    // Connect edits recompile on the next query
+    auto def = db.make_def();
+    def.set_connects( vd::vert_connects{ db.id( 12 ) } );
+    db.update( 0, def );
+    REQUIRE( db.adjacency().neighbours( 0 ).size() == 1 );
+    REQUIRE( db.find_connects( 0 ) == SimpleTestDB::results_type{ 12 } );
+
+    // Erased verts drop out of their neighbours' rows
+    db.erase( 12 );
+    REQUIRE( db.adjacency().neighbours( 0 ).empty() );
+}
+
+TEST_CASE( "vert_db traversal contexts and parallel connects", "[vert_db]" )
+{
+    SimpleTestDB db;
+    add_sphere( db, 10, 100, 100 );
+
+    // One context serves many queries without clearing
+    SimpleTestDB::traversal_type context;
+    for( size_t key = 0; key < 50; ++key )
+    {
+        SimpleTestDB::key_collection frontier{ key };
+        SimpleTestDB::key_collection fresh_frontier{ key };
+        auto reused = db.find_connects( frontier, 3, true, context );
+        auto fresh = db.find_connects( fresh_frontier, 3, true );
+        REQUIRE( reused == fresh );
+    }
+
+    // Many sources make levels large enough to expand in parallel
+    SimpleTestDB::key_collection sources;
+    for( size_t key = 0; key < db.size(); key += 4 )
+    {
+        sources.emplace_back( key );
+    }
+
+    SimpleTestDB::key_collection frontier( sources );
+    auto expected = db.find_connects( frontier, 2, true );
+    auto found = db.find_connects_parallel( sources, 2, true, context );
+    REQUIRE( found.size() == expected.size() );
+
+    std::sort( expected.begin(), expected.end() );
+    std::sort( found.begin(), found.end() );
+    REQUIRE( found == expected );
+}
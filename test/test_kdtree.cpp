@@ -0,0 +1,121 @@
+#include "catch2/catch.hpp"
+
+#include "fixtures.h"
+
+#include "vert_db/vert_db_kdtree.h"
+
+TEST_CASE( "kd_tree matches point_cloud queries", "[kd_tree]" )
+{
+    size_t count = 2000;
+
+    vd::point_cloud<size_t> cloud;
+    std::vector<vd::vec3> points = add_random_points( cloud, count );
+
+    vd::kd_tree<size_t> tree;
+    for( size_t i = 0; i < points.size(); ++i )
+    {
+        tree.insert( points[i], i );
+    }
+    REQUIRE( tree.size() == count );
+
+    RandomReal<vd::real> r( -1.0f, 11.0f );
+    for( size_t probe_index = 0; probe_index < 100; ++probe_index )
+    {
+        vd::vec3 probe{ r(), r(), r() };
+
+        auto expected = cloud.find( probe, 1.5f );
+        auto found = tree.find( probe, 1.5f );
+        std::sort( expected.begin(), expected.end() );
+        std::sort( found.begin(), found.end() );
+        REQUIRE( found == expected );
+
+        auto expected_nearest = cloud.find_k_nearest( probe, 5 );
+        auto found_nearest = tree.find_k_nearest( probe, 5 );
+        REQUIRE( found_nearest == expected_nearest );
+    }
+
+    // Inserting after a query should rebuild on the next one
+    vd::vec3 extra{ 50, 50, 50 };
+    tree.insert( extra, count );
+    size_t nearest = 0;
+    REQUIRE( tree.find_nearest( vd::vec3{ 49, 49, 49 }, nearest ) );
+    REQUIRE( nearest == count );
+
+    // Moving and erasing also rebuild
+    tree.move( extra, points[0], count );
+    REQUIRE( !tree.find_nearest( vd::vec3{ 49, 49, 49 }, nearest, 5 ) );
+    REQUIRE( tree.erase( points[0], count ) );
+    REQUIRE( !tree.erase( points[0], count ) );
+    REQUIRE( tree.count() == count );
+    REQUIRE( tree.find( points[0] ) == std::vector<size_t>{ 0 } );
+}
+
+TEST_CASE( "kd_tree edits between queries stay exact", "[kd_tree]" )
+{
+    size_t count = 1000;
+
+    vd::point_cloud<size_t> cloud;
+    std::vector<vd::vec3> points = add_random_points( cloud, count );
+
+    vd::kd_tree<size_t> tree;
+    for( size_t i = 0; i < points.size(); ++i )
+    {
+        tree.insert( points[i], i );
+    }
+
+    RandomReal<vd::real> r( -1.0f, 11.0f );
+    RandomReal<vd::real> nudge( -.05f, .05f );
+    for( size_t round = 0; round < 20; ++round )
+    {
+        // Small nudges mostly stay inside their leaf, so many of these keep the tree built
+        for( size_t i = round; i < count; i += 7 )
+        {
+            vd::vec3 moved = points[i] + vd::vec3{ nudge(), nudge(), nudge() };
+            tree.move( points[i], moved, i );
+            cloud.move( points[i], moved, i );
+            points[i] = moved;
+        }
+
+        size_t doomed = round * 13;
+        REQUIRE( tree.erase( points[doomed], doomed ) == cloud.erase( points[doomed], doomed ) );
+        REQUIRE( tree.count() == cloud.count() );
+
+        for( size_t probe_index = 0; probe_index < 10; ++probe_index )
+        {
+            vd::vec3 probe{ r(), r(), r() };
+
+            auto expected = cloud.find( probe, 1.5f );
+            auto found = tree.find( probe, 1.5f );
+            std::sort( expected.begin(), expected.end() );
+            std::sort( found.begin(), found.end() );
+            REQUIRE( found == expected );
+
+            REQUIRE( tree.find_k_nearest( probe, 5 ) == cloud.find_k_nearest( probe, 5 ) );
+        }
+    }
+}
+
+TEST_CASE( "vert_db can use a kd_tree index", "[kd_tree]" )
+{
+    vd::vert_db<size_t, vd::real, vd::kd_tree> db;
+
+    SimpleRandom r;
+    std::vector<vd::vec3> points;
+    for( size_t i = 0; i < 200; ++i )
+    {
+        vd::vec3 point{ r(), r(), r() };
+        points.emplace_back( point );
+
+        auto def = db.make_def();
+        def.set_id( i );
+        def.set_position( point );
+        db.insert( def );
+    }
+
+    for( size_t i = 0; i < points.size(); ++i )
+    {
+        auto found = db.find_position( points[i] );
+        REQUIRE( std::find( found.begin(), found.end(), i ) != found.end() );
+        REQUIRE( db.find_nearest_position( points[i] ) == i );
+    }
+}
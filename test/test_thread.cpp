@@ -0,0 +1,118 @@
+#include "catch2/catch.hpp"
+
+#include "fixtures.h"
+
+#include <numeric>
+#include <stdexcept>
+
+namespace
+{
+    typedef std::vector<size_t> IndexData;
+
+    struct CopyFunc
+    {
+        void operator()( size_t value, IndexData &collector )
+        {
+            collector.emplace_back( value );
+        }
+    };
+
+    struct NestedFunc
+    {
+        void operator()( size_t value, IndexData &collector )
+        {
+            // Nested loops must run inline on the worker that reached them
+            if( vd::thread_pool::in_parallel() )
+                ++inline_hits;
+
+            IndexData inner( 4, value );
+            IndexData inner_results;
+            CopyFunc copier;
+            vd::threaded_processor<CopyFunc, IndexData::iterator, IndexData> processor( copier, inner.begin(), inner.end(), inner_results, 0, pool );
+            processor.join();
+
+            collector.insert( collector.end(), inner_results.begin(), inner_results.end() );
+        }
+
+        vd::thread_pool &pool;
+        std::atomic<size_t> inline_hits;
+    };
+}
+
+TEST_CASE( "thread_pool runs every item once", "[thread_pool]" )
+{
+    vd::thread_pool pool( 3 );
+    REQUIRE( pool.thread_count() == 3 );
+
+    IndexData items( 1000 );
+    std::iota( items.begin(), items.end(), 0 );
+
+    IndexData results;
+    CopyFunc copier;
+    vd::threaded_processor<CopyFunc, IndexData::iterator, IndexData> processor( copier, items.begin(), items.end(), results, 0, pool );
+    processor.join();
+
+    std::sort( results.begin(), results.end() );
+    REQUIRE( results == items );
+
+    // Resizing the pool should keep it usable
+    pool.resize( 1 );
+    REQUIRE( pool.thread_count() == 1 );
+
+    IndexData resized_results;
+    vd::threaded_processor<CopyFunc, IndexData::iterator, IndexData> resized( copier, items.begin(), items.end(), resized_results, 0, pool );
+    resized.join();
+    REQUIRE( resized_results.size() == items.size() );
+}
+
+TEST_CASE( "thread_pool runs nested regions inline", "[thread_pool]" )
+{
+    vd::thread_pool pool( 2 );
+
+    IndexData items( 64 );
+    std::iota( items.begin(), items.end(), 0 );
+
+    IndexData results;
+    NestedFunc nester{ pool, {} };
+    nester.inline_hits = 0;
+    vd::threaded_processor<NestedFunc, IndexData::iterator, IndexData> processor( nester, items.begin(), items.end(), results, 0, pool );
+    processor.join();
+
+    REQUIRE( results.size() == items.size() * 4 );
+    REQUIRE( nester.inline_hits == items.size() );
+    REQUIRE( !vd::thread_pool::in_parallel() );
+}
+
+TEST_CASE( "thread_pool restores the parallel flag when a task throws", "[thread_pool]" )
+{
+    vd::thread_pool pool( 1 );
+
+    // Park the only worker so the throwing task is left for this thread
+    std::atomic<bool> started( false );
+    std::atomic<bool> release( false );
+    pool.submit( [&]
+    {
+        started = true;
+        while( !release )
+            std::this_thread::yield();
+    } );
+
+    while( !started )
+        std::this_thread::yield();
+
+    pool.submit( [] { throw std::runtime_error( "task failed" ); } );
+
+    bool thrown = false;
+    try
+    {
+        pool.run_pending();
+    }
+    catch( const std::runtime_error & )
+    {
+        thrown = true;
+    }
+
+    release = true;
+    REQUIRE( thrown );
+    REQUIRE( !vd::thread_pool::in_parallel() );
+}
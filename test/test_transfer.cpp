@@ -4,6 +4,8 @@
 
 #include "vert_db/vert_db_transfer_utils.h"
 
+#include <sstream>
+
 TEST_CASE( "transfer physical works correctly", "[vert_db]" )
 {
     const size_t sphere_dim = 20;
@@ -38,4 +40,222 @@ TEST_CASE( "transfer physical works correctly", "[vert_db]" )
 
     // TODO: need negative test here too.
     REQUIRE( db.find_weights(probe, sample_radius) == skinner.vert_db().find_weights(probe_kernel, sample_radius));
-}
\ No newline at end of file
+}
+
+TEST_CASE( "transfer mappings replay a transfer", "[vert_db]" )
+{
+    const vd::real sphere_radius = 10;
+    vd::item_flags set_flags = vd::k_item_color | vd::k_item_weights;
+
+    vd::transfer_db<size_t> source;
+    source.add_resolver< vd::transfer_resolver_matched<size_t> >( set_flags );
+    source.add_resolver< vd::transfer_resolver_gaussian<size_t> >( set_flags, sphere_radius / 5 );
+    source.add_resolver< vd::transfer_flood_fill<size_t> >( set_flags );
+    add_sphere( source.vert_db(), sphere_radius, 20, 20 );
+
+    vd::item_flags dest_flags = vd::flag_without( vd::k_item_all, set_flags );
+    SimpleTestDB recorded;
+    add_sphere( recorded, sphere_radius, 30, 30, dest_flags );
+
+    vd::transfer_db<size_t>::mapping_type mapping;
+    source.record( recorded, mapping );
+    REQUIRE( !mapping.empty() );
+    REQUIRE( mapping.rules().size() == 2 );
+
+    // Rows blend cannot read are refused
+    size_t row_count = mapping.size();
+    REQUIRE( !mapping.add_row( 0, 0, {}, {} ) );
+    REQUIRE( !mapping.add_row( 0, 0, { 1, 2 }, { 1 } ) );
+    REQUIRE( !mapping.add_row( 0, mapping.rules().size(), { 1 }, { 1 } ) );
+    REQUIRE( mapping.size() == row_count );
+
+    // Artists repaint the source
+    auto &source_db = source.vert_db();
+    for( const auto &key : source_db )
+    {
+        vd::bone_weights weights{ { "joint_0", .25f }, { "joint_1", .75f } };
+        auto def = source_db.make_def();
+        def.set_color( vd::vec3{ 1, static_cast<vd::real>( key ), 0 } );
+        def.set_weights( weights );
+        source_db.update( key, def );
+    }
+
+    // Replaying the mapping matches running every resolver again
+    SimpleTestDB resolved;
+    add_sphere( resolved, sphere_radius, 30, 30, dest_flags );
+    source.apply( resolved );
+
+    SimpleTestDB replayed;
+    add_sphere( replayed, sphere_radius, 30, 30, dest_flags );
+    source.replay( mapping, replayed );
+    REQUIRE( replayed == resolved );
+
+    // Mappings survive a round trip through a stream
+    std::stringstream stream;
+    REQUIRE( mapping.write( stream ) );
+
+    vd::transfer_db<size_t>::mapping_type loaded;
+    REQUIRE( loaded.read( stream ) );
+    REQUIRE( loaded == mapping );
+
+    SimpleTestDB reloaded;
+    add_sphere( reloaded, sphere_radius, 30, 30, dest_flags );
+    source.replay( loaded, reloaded );
+    REQUIRE( reloaded == resolved );
+
+    // Truncated data is rejected
+    std::string data = stream.str();
+    std::stringstream truncated( data.substr( 0, data.size() / 2 ) );
+    REQUIRE( !loaded.read( truncated ) );
+    REQUIRE( loaded.empty() );
+
+    // Corrupt counts are rejected without trusting them for an allocation
+    auto corrupt_count = [&]( size_t offset )
+    {
+        std::string corrupted = data;
+        unsigned long long count = ~0ull >> 4;
+        corrupted.replace( offset, sizeof( count ), reinterpret_cast<const char*>( &count ), sizeof( count ) );
+
+        std::stringstream corrupted_stream( corrupted );
+        return loaded.read( corrupted_stream );
+    };
+
+    // The key count follows the header and rules; the weight count is the last one before the weights
+    size_t rule_size = sizeof( vd::item_flags_backing ) + 1 + sizeof( unsigned long long ) + sizeof( vd::real ) + 1;
+    size_t keys_offset = 24 + ( mapping.rules().size() * rule_size );
+    size_t source_count = 0;
+    for( size_t i = 0; i < mapping.size(); ++i )
+    {
+        source_count += mapping[i].m_count;
+    }
+
+    size_t weights_offset = data.size() - ( source_count * sizeof( vd::real ) ) - sizeof( unsigned long long );
+
+    REQUIRE( !corrupt_count( keys_offset ) );
+    REQUIRE( loaded.empty() );
+    REQUIRE( !corrupt_count( weights_offset ) );
+    REQUIRE( loaded.empty() );
+}
+
+TEST_CASE( "flood fill advances one ring per generation", "[vert_db]" )
+{
+    const size_t ring_size = 25;
+    vd::vec3 color{ .25f, .5f, 1 };
+
+    auto make_ring = [&]( SimpleTestDB &db )
+    {
+        add_random_ring( db, ring_size );
+
+        auto def = db.make_def();
+        def.set_color( color );
+        db.update( 0, def );
+    };
+
+    // Three generations reach three verts either way around the ring
+    SimpleTestDB shallow;
+    make_ring( shallow );
+
+    vd::transfer_db<size_t> limited;
+    limited.add_resolver< vd::transfer_flood_fill<size_t> >( vd::k_item_color, 3 );
+    limited.apply( shallow );
+
+    size_t colored = 0;
+    for( const auto &key : shallow )
+    {
+        size_t hops = ( key < ring_size - key ) ? key : ring_size - key;
+        bool has_color = vd::flag_is_set( shallow.channels( key ), vd::k_item_color );
+        REQUIRE( has_color == ( hops <= 3 ) );
+        colored += has_color ? 1 : 0;
+    }
+
+    REQUIRE( colored == 7 );
+
+    // Unlimited fills reach the whole ring, carrying the seed's color
+    SimpleTestDB full;
+    make_ring( full );
+
+    vd::transfer_db<size_t> unlimited;
+    unlimited.add_resolver< vd::transfer_flood_fill<size_t> >( vd::k_item_color );
+    unlimited.apply( full );
+
+    for( const auto &key : full )
+    {
+        REQUIRE( vd::near_equal( full.color( key ), color, static_cast<vd::real>( 1e-5 ) ) );
+    }
+}
+
+TEST_CASE( "geodesic fill blends seeds by distance along the mesh", "[vert_db]" )
+{
+    // An open chain spaced further apart towards its end, seeded red at one end and blue at the other
+    const size_t chain_size = 11;
+    const vd::real chain_length = 100;
+    vd::vec3 red{ 1, 0, 0 };
+    vd::vec3 blue{ 0, 0, 1 };
+
+    auto make_chain = [&]( SimpleTestDB &db )
+    {
+        for( size_t i = 0; i < chain_size; ++i )
+        {
+            auto def = db.make_def();
+            def.set_id( i );
+            def.set_position( vd::vec3{ static_cast<vd::real>( i * i ), 0, 0 } );
+
+            vd::vert_connects connects;
+            if( i > 0 )
+                connects.emplace_back( i - 1 );
+
+            if( i + 1 < chain_size )
+                connects.emplace_back( i + 1 );
+
+            def.set_connects( connects );
+            if( i == 0 )
+                def.set_color( red );
+
+            if( i == chain_size - 1 )
+                def.set_color( blue );
+
+            db.insert( def );
+        }
+    };
+
+    // Blending both seeds by inverse distance interpolates linearly along the chain, not by hops
+    SimpleTestDB blended;
+    make_chain( blended );
+
+    vd::transfer_db<size_t> both;
+    both.add_resolver< vd::transfer_geodesic_fill<size_t> >( vd::k_item_color, 2 );
+    both.apply( blended );
+
+    for( const auto &key : blended )
+    {
+        vd::real x = blended.position( key ).x;
+        vd::vec3 expected{ ( chain_length - x ) / chain_length, 0, x / chain_length };
+        REQUIRE( vd::near_equal( blended.color( key ), expected, static_cast<vd::real>( 1e-5 ) ) );
+    }
+
+    // With one source and a distance limit, verts take the nearest seed's color or are left for later
+    const vd::real max_distance = 30;
+
+    SimpleTestDB limited;
+    make_chain( limited );
+
+    vd::transfer_db<size_t> nearest;
+    nearest.add_resolver< vd::transfer_geodesic_fill<size_t> >( vd::k_item_color, 1, max_distance );
+    nearest.apply( limited );
+
+    size_t colored = 0;
+    for( const auto &key : limited )
+    {
+        vd::real x = limited.position( key ).x;
+        bool has_color = vd::flag_is_set( limited.channels( key ), vd::k_item_color );
+        REQUIRE( has_color == ( ( x <= max_distance ) || ( chain_length - x <= max_distance ) ) );
+
+        if( has_color )
+        {
+            REQUIRE( vd::near_equal( limited.color( key ), ( x < chain_length / 2 ) ? red : blue, static_cast<vd::real>( 1e-5 ) ) );
+            ++colored;
+        }
+    }
+
+    REQUIRE( colored == 8 );
+}
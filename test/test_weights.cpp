@@ -40,3 +40,88 @@ TEST_CASE( "vert_db skin weight queries", "[vert_db]" )
     vd::bone_weights miss = db.find_weights( miss_probe, .25f, 4 );
     REQUIRE( miss.size() == 0 );
 }
+
+TEST_CASE( "vert_db interns bone names", "[vert_db]" )
+{
+    SimpleTestDB db;
+    add_sphere( db, 10, 20, 20 );
+
+    // One bone per sphere row
+    const vd::bone_palette &bones = db.bones();
+    REQUIRE( bones.size() == 20 );
+    REQUIRE( bones.find( "joint_3" ) != vd::bone_palette::invalid_index() );
+    REQUIRE( bones.name( bones.find( "joint_3" ) ) == "joint_3" );
+    REQUIRE( bones.find( "missing" ) == vd::bone_palette::invalid_index() );
+
+    // Names round trip through the indexed storage
+    auto def = db.make_def();
+    vd::bone_weights weights{ { "joint_3", .75f }, { "extra", .25f } };
+    def.set_weights( weights );
+    db.update( 0, def );
+    REQUIRE( db.weights( 0 ) == weights );
+    REQUIRE( bones.size() == 21 );
+
+    auto indices = db.weight_indices( 0 );
+    REQUIRE( indices.size() == 2 );
+    REQUIRE( bones.name( indices[0].first ) == "joint_3" );
+
+    // Indexed queries agree with named ones
+    vd::vec3 probe = db.position( 25 );
+    auto named = db.find_weights( probe, 2, 2 );
+    REQUIRE( bones.resolve( db.find_weight_indices( probe, 2, 2 ) ) == named );
+
+    // Palettes built in a different order still compare equal by name
+    SimpleTestDB other;
+    auto first = other.make_def();
+    first.set_weights( vd::bone_weights{ { "extra", 1.0f } } );
+    other.insert( first );
+    other.update( 0, def );
+    SimpleTestDB same;
+    same.insert( def );
+    REQUIRE( other.channel_equal( same, vd::k_item_weights ) );
+}
+
+TEST_CASE( "inline weights keep the heaviest influences", "[vert_db]" )
+{
+    vd::inline_weights<3> weights;
+    REQUIRE( weights.add( 0, .1f ) );
+    REQUIRE( weights.add( 1, .4f ) );
+    REQUIRE( weights.add( 2, .2f ) );
+    REQUIRE( !weights.add( 3, .05f ) );
+    REQUIRE( weights.add( 4, .3f ) );
+
+    REQUIRE( weights.size() == 3 );
+    REQUIRE( weights[0].first == 1 );
+    REQUIRE( weights[1].first == 4 );
+    REQUIRE( weights[2].first == 2 );
+
+    // Adding to an existing bone merges and re-sorts
+    REQUIRE( weights.add( 2, .3f ) );
+    REQUIRE( weights.size() == 3 );
+    REQUIRE( weights[0].first == 2 );
+    REQUIRE( weights[0].second == Approx( .5f ) );
+
+    typedef vd::vert_db<size_t, vd::real, vd::point_cloud, 4> CappedDB;
+    CappedDB db;
+
+    auto def = db.make_def();
+    def.set_position( vd::vec3{ 0, 0, 0 } );
+    def.set_weights( vd::bone_weights{ { "a", .05f }, { "b", .3f }, { "c", .1f }, { "d", .25f }, { "e", .2f }, { "f", .1f } } );
+    db.insert( def );
+
+    vd::bone_weights expected{ { "b", .3f }, { "d", .25f }, { "e", .2f }, { "c", .1f } };
+    REQUIRE( db.weights( 0 ) == expected );
+
+    // Queries respect the cap even without an explicit total
+    for( size_t i = 0; i < 4; ++i )
+    {
+        std::string bone( "g" );
+        bone += char( 'a' + i );
+        def.set_position( vd::vec3{ vd::real( i + 1 ) * .1f, 0, 0 } );
+        def.set_weights( vd::bone_weights{ { bone, .6f }, { "a", .4f } } );
+        db.insert( def );
+    }
+
+    vd::bone_weights found = db.find_weights( vd::vec3{ .2f, 0, 0 }, 1, 0, 0 );
+    REQUIRE( found.size() == CappedDB::max_influences() );
+}